@@ -8,11 +8,31 @@
  *
  *****************************************************************************/
 
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <linux/futex.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
 #include <threads.h>
 #include <time.h>
 #include <unistd.h>
@@ -45,10 +65,27 @@
 /* Show the execution trace at the end of a loop */
 #define LOG_EXEC_TRACE false
 
+/*ANCHOR - log: latency */
+/* Show the loop latency statistics of each graph at the end */
+#define LOG_LATENCY true
+
+/*ANCHOR - log: release */
+/* Measure and show the cost of releasing the children of the finished tasks
+   (two clock reads and two atomic operations per task) */
+#define LOG_RELEASE false
+
+/*ANCHOR - log: admission */
+/* Show frames dropped, coalesced or blocked by the admission control */
+#define LOG_ADMISSION false
+
 /*ANCHOR - tasks: jitter */
 /* Add some jitter to the task duration (+/- random 10% of the duration) */
 #define TASK_JITTER false
 
+/*ANCHOR - streams: wakeup */
+/* Max time an idle runner misses a frame handed over by a producer */
+#define STREAM_WAKEUP_NS 1000000L
+
 /*!SECTION - Overall settings */
 #pragma endregion
 
@@ -61,12 +98,32 @@
  *****************************************************************************/
 
 /*ANCHOR - Task */
-/* A task is a pointer to a function: void task(void). In this context, tasks
-   only simulate how long it takes to complete (wait for some ms).
-
-   See below #LINK - Task generator
+/* A task is a callable object: a trampoline and the state it captures,
+   stored inline so that creating or running a task never allocates. Most
+   tasks are plain functions, void task(context_t *context), wrapped in a task
+   object; the context gives access to the runner, e.g. its scratch arena. In
+   this context, tasks only simulate how long it takes to complete (wait for
+   some ms).
+
+   See below #LINK - Callable tasks and #LINK - Task generator
  */
-typedef void (*task_t)(void);
+struct context;
+typedef struct context context_t;
+typedef void (*task_fn_t)(context_t *context);
+
+/*ANCHOR - Task storage */
+/* Bytes of captured state of a task, so a task is a cache line, and their
+   alignment */
+#define TASK_STORAGE 48
+#define TASK_ALIGN 16
+
+typedef struct
+{
+  void (*call)(void *storage, context_t *context); /* trampoline, NULL once moved */
+  _Alignas(TASK_ALIGN) unsigned char storage[TASK_STORAGE];
+} task_t;
+
+_Static_assert(sizeof(task_t) == 64, "task_t must fit in a cache line");
 
 /*ANCHOR - List node */
 /* In a graph, the list of nodes connected to another node. */
@@ -78,6 +135,42 @@ typedef struct lnode lnode_t;
 struct gnode;
 typedef struct gnode gnode_t;
 
+/*ANCHOR - Edge */
+/* Data passed from a parent graph node to a child in each loop. */
+struct edge;
+typedef struct edge edge_t;
+
+/*ANCHOR - Payload */
+/* Output of a graph node shared by the edges to all its children. */
+struct payload;
+typedef struct payload payload_t;
+
+/*ANCHOR - Graph */
+/* A graph is a DAG of graph nodes with its own loop counters, queue of tasks
+   and execution trace. */
+struct graph;
+typedef struct graph graph_t;
+
+/*ANCHOR - Execution time */
+/* Start and end time of a graph loop. */
+struct exec_time;
+typedef struct exec_time exec_time_t;
+
+/*ANCHOR - Readiness bitset */
+/* Alternative to the deps_t counters to find the ready-to-run gnodes. */
+struct bitset;
+typedef struct bitset bitset_t;
+
+/*ANCHOR - Admission control */
+/* Frames offered by a periodic source wait here until a loop can start. */
+struct admission;
+typedef struct admission admission_t;
+
+/*ANCHOR - Frame stream */
+/* Frames pushed by an external thread start the loops of a graph. */
+struct stream;
+typedef struct stream stream_t;
+
 /*!SECTION - Prototypes */
 #pragma endregion
 
@@ -101,6 +194,46 @@ void *mcalloc(size_t size)
   return addr;
 }
 
+/*ANCHOR - mrealloc */
+void *mrealloc(void *addr, size_t size)
+{
+  addr = realloc(addr, size);
+  if (addr == NULL)
+  {
+    fprintf(stderr, "Error in realloc\n");
+    exit(EXIT_FAILURE);
+  }
+  return addr;
+}
+
+/*ANCHOR - now */
+/* Monotonic time, in ns */
+long now_ns(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000L + time.tv_nsec;
+}
+
+/*ANCHOR - random */
+/* Xorshift generator with a state per thread: rand() is not thread-safe and
+   its hidden state would be shared by the runners. The state is seeded on
+   the first call from the time and its own address, distinct per thread. */
+_Thread_local uint64_t random_state = 0;
+
+uint64_t random_next(void)
+{
+  uint64_t x = random_state;
+
+  if (x == 0)
+    x = ((uint64_t)now_ns() ^ (uint64_t)(uintptr_t)&random_state) | 1;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  random_state = x;
+  return x;
+}
+
 /*ANCHOR - mutex: init */
 void mutex_init(mtx_t *mutex)
 {
@@ -133,6 +266,20 @@ void unlock(mtx_t *mutex)
   }
 }
 
+/*ANCHOR - futex: wait */
+/* Futexes are not private: they also work on shared memory mapped by
+   several processes. */
+void futex_wait(atomic_int *addr, int value)
+{
+  syscall(SYS_futex, addr, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+/*ANCHOR - futex: wake */
+void futex_wake(atomic_int *addr, int count)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
 /*ANCHOR - cvar: init*/
 void cvar_init(cnd_t *cvar)
 {
@@ -144,7 +291,7 @@ void cvar_init(cnd_t *cvar)
 }
 
 /*ANCHOR - cvar: wait */
-void wait(cnd_t *cvar, mtx_t *mutex)
+void cvar_wait(cnd_t *cvar, mtx_t *mutex)
 {
   if (cnd_wait(cvar, mutex) != thrd_success)
   {
@@ -153,8 +300,36 @@ void wait(cnd_t *cvar, mtx_t *mutex)
   }
 }
 
+/*ANCHOR - cvar: timed wait */
+/* Returns on a signal or after 'ns' nanoseconds */
+void cvar_timedwait(cnd_t *cvar, mtx_t *mutex, long ns)
+{
+  struct timespec time;
+
+  timespec_get(&time, TIME_UTC);
+  time.tv_nsec += ns;
+  time.tv_sec += time.tv_nsec / 1000000000L;
+  time.tv_nsec %= 1000000000L;
+  int status = cnd_timedwait(cvar, mutex, &time);
+  if (status != thrd_success && status != thrd_timedout)
+  {
+    fprintf(stderr, "Error in cnd_timedwait\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*ANCHOR - cvar: signal */
+void cvar_signal(cnd_t *cvar)
+{
+  if (cnd_signal(cvar) != thrd_success)
+  {
+    fprintf(stderr, "Error in cnd_signal\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
 /*ANCHOR - cvar: broadcast */
-void broadcast(cnd_t *var)
+void cvar_broadcast(cnd_t *var)
 {
   if (cnd_broadcast(var) != thrd_success)
   {
@@ -165,6 +340,94 @@ void broadcast(cnd_t *var)
 /*!SECTION - Utility functions */
 #pragma endregion
 
+/* SECTION - Callable tasks */
+#pragma region
+/*****************************************************************************
+ *
+ *                   TASK OBJECTS WITH INLINE CAPTURED STATE
+ *
+ *****************************************************************************/
+
+/* A task object is move-only by convention, as C struct assignment still
+   copies it: task_move leaves the source empty, and running an empty task is
+   an error. The captured state is copied in the storage of the task, whose
+   size and alignment are checked at compile time by task_capture, e.g.
+     struct { long *counter; long step; } captures = {&counter, 2};
+     task_t task = task_capture(count_task, captures);
+   where count_task(void *storage, context_t *context) gets a pointer to its
+   copy of captures.
+ */
+
+/* SECTION - Functions */
+
+/*ANCHOR - task: function trampoline */
+void impl_task_fn(void *storage, context_t *context)
+{
+  task_fn_t fn;
+
+  memcpy(&fn, storage, sizeof(task_fn_t));
+  fn(context);
+}
+
+/*ANCHOR - task: from function */
+task_t task_fn(task_fn_t fn)
+{
+  task_t task = {.call = impl_task_fn};
+
+  memcpy(task.storage, &fn, sizeof(task_fn_t));
+  return task;
+}
+
+/*ANCHOR - task: constructor */
+/* Use task_capture to check the size of the captures at compile time */
+task_t task_new(void (*call)(void *storage, context_t *context), const void *captures,
+               size_t size)
+{
+  task_t task = {.call = call};
+
+  if (size > TASK_STORAGE)
+  {
+    fprintf(stderr, "Error in task_new: %zu bytes of captures\n", size);
+    exit(EXIT_FAILURE);
+  }
+  if (size > 0)
+    memcpy(task.storage, captures, size);
+  return task;
+}
+
+/*ANCHOR - task: capture */
+#define task_capture(CALL, CAPTURES)                                 \
+  task_new((CALL), &(CAPTURES),                                    \
+           sizeof(CAPTURES) + 0 * sizeof(struct {                  \
+             _Static_assert(sizeof(CAPTURES) <= TASK_STORAGE,      \
+                            "captures do not fit in the task storage"); \
+             _Static_assert(_Alignof(__typeof__(CAPTURES)) <= TASK_ALIGN, \
+                            "captures are over-aligned for the task storage"); \
+             char c;                                               \
+           }))
+
+/*ANCHOR - task: move */
+void task_move(task_t *dst, task_t *src)
+{
+  *dst = *src;
+  src->call = NULL;
+}
+
+/*ANCHOR - task: call */
+void task_call(task_t *task, context_t *context)
+{
+  if (task->call == NULL)
+  {
+    fprintf(stderr, "Error in task_call: empty task\n");
+    exit(EXIT_FAILURE);
+  }
+  task->call(task->storage, context);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Callable tasks */
+#pragma endregion
+
 /* SECTION - List of nodes */
 #pragma region
 /*****************************************************************************
@@ -177,12 +440,14 @@ void broadcast(cnd_t *var)
 
 /*ANCHOR - lnode: struct */
 /* A list node has a pointer to the next list element and a pointer to a graph
-   node.
+   node. In the lists of children and parents it also has a pointer to the
+   edge connecting both graph nodes.
  */
 struct lnode
 {
   lnode_t *next;
   gnode_t *gnode;
+  edge_t *edge;
 };
 /*!SECTION - Types */
 
@@ -195,18 +460,21 @@ lnode_t *lnode_new(gnode_t *gnode)
 
   lnode->next = NULL;
   lnode->gnode = gnode;
+  lnode->edge = NULL;
 
   return lnode;
 }
 
 /*ANCHOR - lnode: append graph node */
-void lnode_append(lnode_t *lnode, gnode_t *gnode)
+lnode_t *lnode_append(lnode_t *lnode, gnode_t *gnode)
 {
   lnode_t *tmp = lnode;
 
   while (tmp->next != NULL)
     tmp = tmp->next;
   tmp->next = lnode_new(gnode);
+
+  return tmp->next;
 }
 /*!SECTION - Functions */
 /*!SECTION - List of nodes */
@@ -241,50 +509,218 @@ typedef struct
  */
 struct gnode
 {
+  int id;
   char label;
   deps_t deps;
   task_t task;
+  size_t payload;     /* size of the task output, in bytes */
+  int level;          /* topological level, 0 for the root */
+  int position;       /* index in the topological order of the graph */
+  bool dirty;         /* changed, see #LINK - Incremental execution */
+  bool affected;      /* runs in the current loop in incremental mode */
+  bool memo;          /* output memoised, see #LINK - Memoisation */
+  long memo_hits;
+  long memo_misses;
+  atomic_long scratch_high; /* see #LINK - Scratch arenas */
+  long cost;          /* estimated duration of the task */
+  long rank;          /* upward rank: cost of the longest path to the end */
+  int group;          /* partition group, see #LINK - Graph partitioning */
   lnode_t *children;
   lnode_t *parents;
+  lnode_t *delays_out; /* delay edges to this gnode in later loops */
+  lnode_t *delays_in;  /* delay edges from gnodes in earlier loops */
+  graph_t *graph;
   mtx_t mutex;
 };
+
+/*ANCHOR - edge: struct */
+/* The output of the parent task is copied to the buffer of each edge to its
+   children. An edge is shared by the lnode in the list of children of the
+   parent and the lnode in the list of parents of the child.
+ */
+struct edge
+{
+  gnode_t *parent;
+  gnode_t *child;
+  size_t size;        /* bytes of the buffer, the payload of the parent */
+  char *buffer;
+  payload_t *payload; /* shared buffer, see #LINK - Payload handles */
+  int versions;       /* buffers, see #LINK - Pipelined executor */
+  long *released;     /* last loop that consumed each version */
+  struct pipeline_item *stalled; /* producers waiting for a version */
+  int delay;          /* loops between parent and child, 0 within a loop */
+};
+
+/*ANCHOR - graph: struct */
+/* A graph holds all its gnodes, indexed by gnode id, and the runtime state of
+   its loops. The first gnode created in a graph is the root, labeled 'A'.
+   Each graph has its own queue of tasks; runners pick tasks from all the
+   registered graphs according to the graph priority and weight (see
+   #LINK - tasks queue: pop front).
+ */
+struct graph
+{
+  int id;
+  char name[32];
+  gnode_t *root;      /* gnode labeled 'A' */
+  gnode_t **nodes;    /* all gnodes, indexed by gnode id */
+  int size;           /* total number of gnodes */
+  int capacity;       /* allocated entries in nodes */
+  gnode_t **order;    /* all gnodes, in topological order, NULL in holes */
+  int order_length;   /* positions in order, holes included */
+  int order_capacity; /* allocated entries in order */
+  int levels;         /* number of topological levels */
+  int *level_count;   /* gnodes in each level */
+  /* reused by the mutations, indexed by gnode id, see #LINK - Graph mutation */
+  int *mark;          /* stamp of the last mutation that visited the gnode */
+  int stamp;
+  gnode_t **work;     /* worklist or stack */
+  int work_length;
+  gnode_t **found;    /* gnodes found by a search */
+  int *positions;
+  int loops;          /* total number of loops to run */
+  int loop;           /* current loop number */
+  int priority;       /* scheduling class, 0 is the most urgent */
+  int weight;         /* share of runners within the scheduling class */
+  int deficit;        /* tasks that can be served in the current round */
+  lnode_t *queue;     /* queue of ready-to-run gnodes */
+  int queue_length;   /* number of gnodes in the queue */
+  long stolen;        /* tasks run out of their group of runners */
+  bitset_t *bitset;   /* readiness bitset, NULL to use the deps_t counters */
+  atomic_long release_ns;    /* time spent releasing children */
+  atomic_long release_edges; /* number of edges released */
+  admission_t *admission; /* periodic loops, NULL for back to back loops */
+  stream_t *stream;   /* loops started by external frames, or NULL */
+  _Atomic(graph_t *) successor; /* published to run from the next loop */
+  bool incremental;   /* run only the changed gnodes and their descendants */
+  gnode_t *end;       /* gnode labeled 'Z', in incremental mode */
+  gnode_t **dirty;    /* gnodes changed since the last loop */
+  int dirty_count;
+  mtx_t dirty_mtx;
+  gnode_t **affected; /* gnodes run in the current loop */
+  int affected_count;
+  long affected_total; /* gnodes run in all loops */
+  char *arena;        /* edge buffers, see #LINK - Memory planner */
+  size_t arena_size;
+  bool payloads;      /* outputs shared by the edges, not copied */
+  exec_time_t *exec_time; /* start and end of each loop */
+  char *exec_trace;   /* see #LINK - exec trace: global var */
+  mtx_t exec_trace_mtx;
+};
 /*!SECTION - Types */
 
 /* SECTION - Variables */
 
-/*ANCHOR - graph: global var */
-/* All tasks operate on the global graph. This variable hold a pointer to the
-gnode labeled 'A'. */
-gnode_t *graph;
+/*ANCHOR - graphs: registry */
+/* All graphs registered to be run by the pool of runners, indexed by graph
+   id. */
+graph_t **graphs = NULL;
 
-/*ANCHOR - graph: size */
-/* Total number of gnodes */
-int graph_size = 0;
+/*ANCHOR - graphs: count */
+int graphs_count = 0;
 
-/*ANCHOR - graph: loops */
-/* Total number of loops to run */
-int graph_loops;
+/*ANCHOR - graphs: done */
+/* Number of graphs that have completed all their loops */
+atomic_int graphs_done;
 
-/*ANCHOR - graph: loop */
-/* Current loop number */
-int graph_loop;
+/*ANCHOR - graphs: frames */
+/* Number of different frames processed by the root, cyclically */
+int graphs_frames = INT_MAX;
 
 /*!SECTION - Variables */
 
 /* SECTION - Functions */
 
+/*ANCHOR - graph: constructor */
+graph_t *graph_new(const char *name)
+{
+  graph_t *graph = (graph_t *)mcalloc(sizeof(graph_t));
+
+  graph->id = -1;
+  snprintf(graph->name, sizeof(graph->name), "%s", name);
+  graph->root = NULL;
+  graph->nodes = NULL;
+  graph->size = 0;
+  graph->capacity = 0;
+  graph->order = NULL;
+  graph->order_length = 0;
+  graph->order_capacity = 0;
+  graph->levels = 0;
+  graph->level_count = NULL;
+  graph->mark = NULL;
+  graph->stamp = 0;
+  graph->work = NULL;
+  graph->work_length = 0;
+  graph->found = NULL;
+  graph->positions = NULL;
+  graph->loops = 0;
+  graph->loop = 0;
+  graph->priority = 0;
+  graph->weight = 1;
+  graph->deficit = 0;
+  graph->queue = NULL;
+  graph->queue_length = 0;
+  graph->stolen = 0;
+  graph->bitset = NULL;
+  atomic_init(&graph->release_ns, 0);
+  atomic_init(&graph->release_edges, 0);
+  graph->admission = NULL;
+  graph->stream = NULL;
+  graph->exec_time = NULL;
+  graph->exec_trace = NULL;
+  atomic_init(&graph->successor, NULL);
+  graph->incremental = false;
+  graph->end = NULL;
+  graph->dirty = NULL;
+  graph->affected = NULL;
+  graph->arena = NULL;
+  graph->arena_size = 0;
+  graph->payloads = false;
+
+  return graph;
+}
+
 /*ANCHOR - gnode: constructor */
-gnode_t *gnode_new(char label, task_t task)
+void impl_mutation_grow(graph_t *graph, int capacity);
+
+gnode_t *gnode_new(graph_t *graph, char label, task_fn_t task)
 {
   gnode_t *gnode = (gnode_t *)mcalloc(sizeof(gnode_t));
 
-  graph_size++;
+  if (graph->size == graph->capacity)
+  {
+    int capacity = graph->capacity;
+    graph->capacity = graph->capacity == 0 ? 16 : 2 * graph->capacity;
+    graph->nodes = mrealloc(graph->nodes, sizeof(gnode_t *) * graph->capacity);
+    if (graph->order != NULL)
+      impl_mutation_grow(graph, capacity);
+  }
+  gnode->id = graph->size;
+  graph->nodes[graph->size++] = gnode;
+  if (graph->root == NULL)
+    graph->root = gnode;
+
+  gnode->graph = graph;
   gnode->label = label;
   gnode->deps.required = 0;
   gnode->deps.satisfied = 0;
-  gnode->task = task;
+  gnode->task = task_fn(task);
+  gnode->payload = 0;
+  gnode->level = 0;
+  gnode->position = 0;
+  gnode->dirty = false;
+  gnode->affected = false;
+  gnode->memo = false;
+  gnode->memo_hits = 0;
+  gnode->memo_misses = 0;
+  atomic_init(&gnode->scratch_high, 0);
+  gnode->cost = 1;
+  gnode->rank = 0;
+  gnode->group = 0;
   gnode->children = NULL;
   gnode->parents = NULL;
+  gnode->delays_out = NULL;
+  gnode->delays_in = NULL;
   mutex_init(&gnode->mutex);
 
   return gnode;
@@ -296,31 +732,92 @@ gnode_t *gnode_new(char label, task_t task)
  */
 void gnode_child(gnode_t *parent, gnode_t *child)
 {
+  edge_t *edge = (edge_t *)mcalloc(sizeof(edge_t));
+  lnode_t *lnode;
+
+  edge->parent = parent;
+  edge->child = child;
+  edge->size = 0;
+  edge->buffer = NULL;
+  edge->payload = NULL;
+  edge->versions = 1;
+  edge->released = NULL;
+  edge->stalled = NULL;
+  edge->delay = 0;
+
   if (parent->children == NULL)
-    parent->children = lnode_new(child);
+    lnode = parent->children = lnode_new(child);
   else
-    lnode_append(parent->children, child);
+    lnode = lnode_append(parent->children, child);
+  lnode->edge = edge;
   child->deps.required++;
 
   if (child->parents == NULL)
-    child->parents = lnode_new(parent);
+    lnode = child->parents = lnode_new(parent);
   else
-    lnode_append(child->parents, parent);
+    lnode = lnode_append(child->parents, parent);
+  lnode->edge = edge;
 }
 
 /*ANCHOR - gnode: add new child */
 /* Link two graph nodes, parent --> child. Child node is created with the
    indicated label.
  */
-gnode_t *gnode_child_new(gnode_t *parent, char label, task_t task)
+gnode_t *gnode_child_new(gnode_t *parent, char label, task_fn_t task)
 {
-  gnode_t *child = gnode_new(label, task);
+  gnode_t *child = gnode_new(parent->graph, label, task);
 
   gnode_child(parent, child);
 
   return child;
 }
 
+/*ANCHOR - gnode: task */
+/* Replace the task of the gnode, e.g. by a task capturing state; the task is
+   moved into the gnode. */
+void gnode_task(gnode_t *gnode, task_t *task)
+{
+  task_move(&gnode->task, task);
+}
+
+/*ANCHOR - gnode: add delay edge */
+/* Loop-carried dependency: the child in loop N + delay waits for the parent
+   in loop N, e.g. a gnode keeping state across frames depends on itself with
+   a delay of 1. Delay edges carry no data and can go backwards, so they are
+   not part of the cycle check nor of the topological order. Loops run one
+   after the other satisfy them; see #LINK - Pipelined executor otherwise.
+ */
+void gnode_delay(gnode_t *parent, gnode_t *child, int delay)
+{
+  edge_t *edge;
+  lnode_t *lnode;
+
+  if (delay < 1)
+  {
+    fprintf(stderr, "Error in graph %s: delay %c --> %c of %d loops\n",
+            parent->graph->name, parent->label, child->label, delay);
+    exit(EXIT_FAILURE);
+  }
+
+  edge = (edge_t *)mcalloc(sizeof(edge_t));
+  edge->parent = parent;
+  edge->child = child;
+  edge->versions = 1;
+  edge->delay = delay;
+
+  if (parent->delays_out == NULL)
+    lnode = parent->delays_out = lnode_new(child);
+  else
+    lnode = lnode_append(parent->delays_out, child);
+  lnode->edge = edge;
+
+  if (child->delays_in == NULL)
+    lnode = child->delays_in = lnode_new(parent);
+  else
+    lnode = lnode_append(child->delays_in, parent);
+  lnode->edge = edge;
+}
+
 /*ANCHOR - gnode: get from label */
 gnode_t *gnode_get(gnode_t *gnode, char label)
 {
@@ -383,455 +880,7845 @@ void gnode_print(gnode_t *gnode)
   if (!PRINT_GRAPH)
     return;
 
-  char *gnode_labels = mcalloc(sizeof(char) * (graph_size + 1));
+  char *gnode_labels = mcalloc(sizeof(char) * (gnode->graph->size + 1));
 
-  printf("graph:\n");
+  printf("graph %s:\n", gnode->graph->name);
   impl_gnode_print(gnode, gnode_labels);
   free(gnode_labels);
 }
-/*!SECTION - Functions */
-/*!SECTION - Graph of tasks */
-#pragma endregion
 
-/* SECTION - Queue of tasks */
-#pragma region
-/*****************************************************************************
- *
- *                   TASKS QUEUE DEFINITION AND MANAGEMENT
- *
- *****************************************************************************/
+/*ANCHOR - graph: compile (cycle) */
+/* Report a cycle among the gnodes that Kahn's algorithm could not order: each
+   of them has at least one parent that could not be ordered either, so going
+   up through such parents eventually repeats a gnode.
+ */
+void impl_graph_cycle(graph_t *graph, int *pending)
+{
+  int *step = mcalloc(sizeof(int) * graph->size);
+  gnode_t **path = mcalloc(sizeof(gnode_t *) * (graph->size + 1));
+  gnode_t *gnode = NULL;
+  int length = 0;
 
-/* SECTION - Variables */
+  for (int i = 0; i < graph->size && gnode == NULL; i++)
+    if (pending[i] > 0)
+      gnode = graph->nodes[i];
+
+  while (step[gnode->id] == 0)
+  {
+    path[length++] = gnode;
+    step[gnode->id] = length;
+    lnode_t *parent = gnode->parents;
+    while (pending[parent->gnode->id] == 0)
+      parent = parent->next;
+    gnode = parent->gnode;
+  }
 
-/*ANCHOR - task queue: global var */
-lnode_t *tasks_queue = NULL;
+  /* the path goes from children to parents */
+  fprintf(stderr, "Error in graph %s: cycle %c", graph->name, gnode->label);
+  for (int i = length - 1; i >= step[gnode->id] - 1; i--)
+    fprintf(stderr, " --> %c", path[i]->label);
+  fprintf(stderr, "\n");
 
-/*ANCHOR - task queue: length */
-int tasks_queue_length = 0;
+  free(step);
+  free(path);
+}
 
-/*ANCHOR - task queue: mutex */
-mtx_t tasks_queue_mtx;
+/*ANCHOR - graph: compile */
+/* Validate the graph and precompute the topological order, the level and the
+   upward rank of each gnode with Kahn's algorithm, in O(V + E). The root must be the only
+   gnode without parents and there must be no cycles; otherwise runners would
+   wait forever for dependencies that are never satisfied, so the program
+   fails here instead.
+ */
+void graph_compile(graph_t *graph)
+{
+  int *pending = mcalloc(sizeof(int) * graph->size);
+  int length = 0;
 
-/*ANCHOR - task queue: cond var */
-cnd_t tasks_queue_cvar;
+  free(graph->order);
+  graph->order = mcalloc(sizeof(gnode_t *) * graph->size);
+  graph->levels = 0;
 
-/*!SECTION - Variables */
+  for (int i = 0; i < graph->size; i++)
+  {
+    gnode_t *gnode = graph->nodes[i];
+    pending[i] = gnode->deps.required;
+    gnode->level = 0;
+    if (pending[i] == 0 && gnode != graph->root)
+    {
+      fprintf(stderr, "Error in graph %s: node %c has no parents\n", graph->name,
+              gnode->label);
+      exit(EXIT_FAILURE);
+    }
+  }
 
-/* SECTION - Functions */
+  graph->order[length++] = graph->root;
+  for (int i = 0; i < length; i++)
+  {
+    gnode_t *gnode = graph->order[i];
+    if (gnode->level + 1 > graph->levels)
+      graph->levels = gnode->level + 1;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    {
+      if (child->gnode->level < gnode->level + 1)
+        child->gnode->level = gnode->level + 1;
+      if (--pending[child->gnode->id] == 0)
+        graph->order[length++] = child->gnode;
+    }
+  }
 
-/*ANCHOR - tasks queue: init */
-void tasks_queue_init()
+  if (length < graph->size)
+  {
+    impl_graph_cycle(graph, pending);
+    exit(EXIT_FAILURE);
+  }
+
+  /* upward ranks, from the end to the root */
+  for (int i = graph->size - 1; i >= 0; i--)
+  {
+    gnode_t *gnode = graph->order[i];
+    gnode->position = i;
+    gnode->rank = 0;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+      if (child->gnode->rank > gnode->rank)
+        gnode->rank = child->gnode->rank;
+    gnode->rank += gnode->cost;
+  }
+  graph->order_length = graph->size;
+  graph->order_capacity = graph->size;
+
+  /* gnodes per level and scratch of the mutations, see #LINK - Graph mutation */
+  impl_mutation_grow(graph, 0);
+  for (int i = 0; i < graph->size; i++)
+    graph->level_count[graph->nodes[i]->level]++;
+
+  free(pending);
+}
+
+/*ANCHOR - graph: validate */
+/* A mutated graph must still run to the end: all gnodes but the root need a
+   parent, and the final gnode 'Z' must be reachable from all of them, or
+   runners would wait forever for a 'Z' that never runs. Returns false if the
+   graph is not valid.
+ */
+bool graph_validate(graph_t *graph)
 {
-  tasks_queue_length = 0;
-  mutex_init(&tasks_queue_mtx);
-  cvar_init(&tasks_queue_cvar);
+  bool *reached = mcalloc(sizeof(bool) * graph->size);
+  gnode_t **stack = mcalloc(sizeof(gnode_t *) * graph->size);
+  int length = 0;
+  bool valid = true;
+
+  for (int i = 0; i < graph->size; i++)
+  {
+    gnode_t *gnode = graph->nodes[i];
+    if (gnode->deps.required == 0 && gnode != graph->root)
+    {
+      fprintf(stderr, "Error in graph %s: node %c has no parents\n", graph->name,
+              gnode->label);
+      valid = false;
+    }
+    if (gnode->label == 'Z' && length == 0)
+    {
+      reached[gnode->id] = true;
+      stack[length++] = gnode;
+    }
+  }
+
+  /* backwards from 'Z' */
+  while (length > 0)
+    for (lnode_t *parent = stack[--length]->parents; parent != NULL; parent = parent->next)
+      if (!reached[parent->gnode->id])
+      {
+        reached[parent->gnode->id] = true;
+        stack[length++] = parent->gnode;
+      }
+
+  for (int i = 0; i < graph->size; i++)
+    if (!reached[i])
+    {
+      fprintf(stderr, "Error in graph %s: node %c does not reach Z\n", graph->name,
+              graph->nodes[i]->label);
+      valid = false;
+    }
+
+  free(reached);
+  free(stack);
+  return valid;
 }
 
-/*ANCHOR - tasks queue: pop front */
-gnode_t *task_queue_pop_front()
+/*ANCHOR - graph: prepare */
+/* Compile the graph and allocate its execution resources. Must be called once
+   the graph has been completely created.
+ */
+void exec_trace_init(graph_t *graph);
+
+void graph_prepare(graph_t *graph)
 {
-  /* must be called right after the wait on the tasks_queue_cvar, with the
-  tasks_queue_mtx locked */
-  lnode_t *lnode = tasks_queue;
-  gnode_t *gnode = tasks_queue->gnode;
+  graph_compile(graph);
+  exec_trace_init(graph);
 
-  tasks_queue = tasks_queue->next;
-  tasks_queue_length--;
-  free(lnode);
+  /* edge buffers, once the payload of all gnodes is known */
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+    {
+      child->edge->size = graph->nodes[i]->payload;
+      if (child->edge->size > 0)
+        child->edge->buffer = mcalloc(child->edge->size);
+    }
+}
 
-  return gnode;
+/*ANCHOR - graph: register */
+/* Make the graph visible to the pool of runners. */
+void graph_register(graph_t *graph)
+{
+  graph_prepare(graph);
+
+  graph->id = graphs_count;
+  graphs = mrealloc(graphs, sizeof(graph_t *) * (graphs_count + 1));
+  graphs[graphs_count++] = graph;
 }
 
-/*ANCHOR - task queue: push back */
-void task_queue_push_back(gnode_t *gnode)
+/*ANCHOR - edge: buffer */
+/* Version of the edge buffer used in the loop */
+char *edge_buffer(edge_t *edge, int loop)
 {
-  lock(&tasks_queue_mtx);
+  return edge->buffer + (size_t)(loop % edge->versions) * edge->size;
+}
+
+/*ANCHOR - gnode: output */
+/* Simulated output of a task: the parent writes its payload in the buffer of
+   the edge to each child, or once if the payload is shared. The output is a
+   function of the inputs; for the root, of the frame of the loop.
+ */
+void *payload_share(gnode_t *gnode);
+
+void gnode_output(gnode_t *gnode, int loop)
+{
+  int value = gnode->label;
+
+  if (gnode->parents == NULL)
+    value += loop % graphs_frames;
+  for (lnode_t *parent = gnode->parents; parent != NULL; parent = parent->next)
+    if (parent->edge->size > 0)
+      value += *(unsigned char *)edge_buffer(parent->edge, loop);
+
+  if (gnode->graph->payloads)
   {
-    if (tasks_queue == NULL)
-      tasks_queue = lnode_new(gnode);
-    else
-      lnode_append(tasks_queue, gnode);
-    tasks_queue_length++;
+    void *data = payload_share(gnode);
+    if (data != NULL)
+      memset(data, value, gnode->payload);
+    return;
   }
-  unlock(&tasks_queue_mtx);
-  broadcast(&tasks_queue_cvar);
+
+  for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    if (child->edge->size > 0)
+      memset(edge_buffer(child->edge, loop), value, child->edge->size);
 }
 /*!SECTION - Functions */
-/*!SECTION - Queue os tasks */
+/*!SECTION - Graph of tasks */
 #pragma endregion
 
-/* SECTION - Execution time & trace */
+/* SECTION - Scratch arenas */
 #pragma region
 /*****************************************************************************
  *
- *                        EXECUTION TIME AND TRACE
+ *                   PER-RUNNER SCRATCH ARENAS FOR THE TASKS
  *
  *****************************************************************************/
 
+/* Temporary buffers of the tasks are taken from a scratch arena owned by the
+   runner, instead of malloc shared by all the runners. A task reaches the
+   arena of its runner through its context argument:
+     char *buffer = scratch_alloc(context, size);
+   Allocations are bumps of an offset and are never freed one by one: the
+   arena is reset after each task, or at the first task of each loop, so a
+   buffer may live until the end of the loop on that runner. The latter needs
+   the loops to run one after the other: not in pipeline mode, where loops
+   overlap, nor with several graphs sharing the runners. Arenas can be
+   backed by huge pages, to save TLB misses. The high-water mark of each gnode
+   (bytes allocated by one run of its task) sizes the arenas.
+ */
+
 /* SECTION - Types */
 
-/*ANCHOR - exec time: type */
-/* The result of 'end - start' is the duration time of a graph loop */
+/*ANCHOR - scratch: arena */
 typedef struct
 {
-  clock_t start;
-  clock_t end;
-} exec_time_t;
-
-/*ANCHOR - exec time: samples */
-/* Used to compute the duration time of each graph loop  */
-exec_time_t *exec_time_samples;
-
+  char *base;
+  size_t size;
+  size_t used;
+  size_t mark; /* used at the start of the task */
+  size_t high; /* max used */
+} scratch_t;
+
+/*ANCHOR - context: struct */
+/* Given to each task by the runner */
+struct context
+{
+  int runner;
+  gnode_t *gnode;    /* task running, NULL in the static executor */
+  graph_t *graph;    /* graph and loop of the last task */
+  int loop;
+  scratch_t scratch; /* empty if there are no scratch arenas */
+};
 /*!SECTION - Types */
 
 /* SECTION - Variables */
 
-/*ANCHOR - exec trace: global var */
-/* An execution trace is a sequence of characters (node labels) indicating the
-start and end of a graph node. It is used to check the validity of a graph
-loop, in which no child starts before all parents have finished. For example,
-if 'A --> a', then a valid trace cannot contain '..A..a..A..'; the trace must
-be like '..A..A..a..'. There is a trace per graph loop.
-*/
-char *exec_trace;
-
-/*ANCHOR - exec trace: mutex */
-mtx_t exec_trace_mtx;
-
+/*ANCHOR - scratch: settings */
+size_t scratch_size = 0; /* bytes of each arena, 0 for no arenas */
+bool scratch_loop = false; /* reset at each loop instead of each task */
+bool scratch_huge = false; /* backed by huge pages */
+
+/*ANCHOR - scratch: statistics */
+/* Pages of the arenas: "hugetlb", "thp" (transparent huge pages) or "4k",
+   probed before the runners start */
+const char *scratch_pages = "4k";
+atomic_int scratch_fallbacks; /* arenas without the reserved huge pages */
+atomic_long scratch_high;
 /*!SECTION - Variables */
 
 /* SECTION - Functions */
 
-/*ANCHOR - exec trace: init */
-/* Depends on the graph_size: must be called after the graph has been created.
- */
-void exec_trace_init()
+/*ANCHOR - scratch: probe */
+/* Pages the arenas can get, with a mapping of the size of an arena */
+void scratch_probe(void)
 {
-  exec_trace = mcalloc(sizeof(char) * (2 * graph_size + 1));
-  mutex_init(&exec_trace_mtx);
-}
+  size_t size = (scratch_size + (2 << 20) - 1) & ~(size_t)((2 << 20) - 1);
+  char *base;
 
-void exec_trace_reset()
-{
-  exec_trace[0] = 0;
+  if (scratch_size == 0 || !scratch_huge)
+    return;
+  base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (base != MAP_FAILED)
+  {
+    scratch_pages = "hugetlb";
+    munmap(base, size);
+    return;
+  }
+  base = mmap(NULL, scratch_size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+  {
+    fprintf(stderr, "Error in mmap\n");
+    exit(EXIT_FAILURE);
+  }
+  if (madvise(base, scratch_size, MADV_HUGEPAGE) == 0)
+    scratch_pages = "thp";
+  munmap(base, scratch_size);
 }
 
-/*ANCHOR - exec trace: append */
-void exec_trace_append(char label)
+/*ANCHOR - context: init */
+void context_init(context_t *context, int runner)
 {
-  int i = 0;
-  lock(&exec_trace_mtx);
+  scratch_t *scratch = &context->scratch;
+
+  context->runner = runner;
+  context->gnode = NULL;
+  context->graph = NULL;
+  context->loop = 0;
+  *scratch = (scratch_t){.base = NULL, .size = 0, .used = 0, .mark = 0, .high = 0};
+  if (scratch_size == 0)
+    return;
+
+  scratch->size = scratch_size;
+  if (strcmp(scratch_pages, "hugetlb") == 0)
   {
-    while (exec_trace[i] != 0)
-      i++;
-    exec_trace[i] = label;
-    exec_trace[i + 1] = 0;
+    /* reserved huge pages; transparent huge pages once they run out */
+    size_t size = (scratch_size + (2 << 20) - 1) & ~(size_t)((2 << 20) - 1);
+    scratch->base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (scratch->base != MAP_FAILED)
+    {
+      scratch->size = size;
+      return;
+    }
+    atomic_fetch_add(&scratch_fallbacks, 1);
+  }
+  scratch->base = mmap(NULL, scratch->size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (scratch->base == MAP_FAILED)
+  {
+    fprintf(stderr, "Error in mmap\n");
+    exit(EXIT_FAILURE);
   }
-  unlock(&exec_trace_mtx);
+  if (scratch_huge)
+    madvise(scratch->base, scratch->size, MADV_HUGEPAGE);
 }
 
-/*!SECTION - Functions */
+/*ANCHOR - context: free */
+/* Called by each runner when it exits */
+void payload_flush(void);
 
-/*!SECTION - Execution time & trace */
-#pragma endregion
+void context_free(context_t *context)
+{
+  long high = context->scratch.high;
+  long seen = atomic_load(&scratch_high);
 
-/* SECTION - Pool of runners */
-#pragma region
-/*****************************************************************************
- *
- *                    RUNNERS DEFINITION AND MANAGEMENT
- *
- *****************************************************************************/
+  while (high > seen && !atomic_compare_exchange_weak(&scratch_high, &seen, high))
+    ;
+  if (context->scratch.base != NULL)
+    munmap(context->scratch.base, context->scratch.size);
+  context->scratch.base = NULL;
+  payload_flush();
+}
 
-/* SECTION - Variables */
+/*ANCHOR - scratch: alloc */
+/* Aligned to 16 bytes; valid until the arena is reset */
+void *scratch_alloc(context_t *context, size_t size)
+{
+  scratch_t *scratch = &context->scratch;
+  size_t offset = (scratch->used + 15) & ~(size_t)15;
 
-/*ANCHOR - runners: active */
-bool runners_active = true;
+  if (offset + size > scratch->size)
+  {
+    fprintf(stderr, "Error in scratch_alloc: %zu bytes, %zu of %zu used\n", size,
+            scratch->used, scratch->size);
+    exit(EXIT_FAILURE);
+  }
+  scratch->used = offset + size;
+  if (scratch->used > scratch->high)
+    scratch->high = scratch->used;
+  return scratch->base + offset;
+}
 
-/*ANCHOR - runners: ids */
-int **runners_id;
+/*ANCHOR - scratch: begin */
+/* Before each task: reset the arena if it is reset at each task, or if the
+   task is the first one of another loop on this runner */
+void scratch_begin(context_t *context, graph_t *graph, int loop)
+{
+  if (!scratch_loop || graph != context->graph || loop != context->loop)
+    context->scratch.used = 0;
+  context->graph = graph;
+  context->loop = loop;
+  context->scratch.mark = context->scratch.used;
+}
 
-/*ANCHOR - runners: pool */
-thrd_t *runners_pool;
+/*ANCHOR - scratch: end */
+/* After each task: bytes allocated by the task */
+size_t scratch_end(context_t *context)
+{
+  return context->scratch.used - context->scratch.mark;
+}
 
-/*ANCHOR - runners: pool_size */
-int runners_pool_size;
+/*ANCHOR - task: run */
+/* Run the task of the gnode in the loop, with the context of the runner */
+void task_run(gnode_t *gnode, context_t *context, int loop)
+{
+  context->gnode = gnode;
+  scratch_begin(context, gnode->graph, loop);
+  task_call(&gnode->task, context);
 
-/*ANCHOR - runners: count */
-atomic_int runners_count;
+  long used = scratch_end(context);
+  long high = atomic_load(&gnode->scratch_high);
+  while (used > high && !atomic_compare_exchange_weak(&gnode->scratch_high, &high, used))
+    ;
+}
 
-/*!SECTION - Variables */
+/*ANCHOR - scratch: print */
+void scratch_print(graph_t *graph)
+{
+  if (scratch_size == 0)
+    return;
+  printf("%s: scratch bytes per task:", graph->name);
+  for (int i = 0; i < graph->size; i++)
+    printf(" %c %ld", graph->nodes[i]->label, atomic_load(&graph->nodes[i]->scratch_high));
+  printf("\n%s: scratch arenas of %zu KiB (%s pages), reset each %s, "
+         "high-water mark %ld bytes\n",
+         graph->name, scratch_size >> 10, scratch_pages,
+         scratch_loop ? "loop" : "task", atomic_load(&scratch_high));
+  if (atomic_load(&scratch_fallbacks) > 0)
+    printf("%s: %d scratch arenas without reserved huge pages\n", graph->name,
+           atomic_load(&scratch_fallbacks));
+}
 
-/* SECTION - Functions */
+/*!SECTION - Functions */
+/*!SECTION - Scratch arenas */
+#pragma endregion
 
-/*ANCHOR - runner: prototypes */
-/* Check finalization conditions*/
-void runner_check_loops();
+/* SECTION - Graph mutation */
+#pragma region
+/*****************************************************************************
+ *
+ *                        INCREMENTAL GRAPH MUTATION
+ *
+ *****************************************************************************/
 
-/* Enqueue ready-to-run child nodes */
-void runner_process_children(gnode_t *gnode);
+/* Nodes and edges can be inserted and deleted in a prepared graph that is not
+   running, e.g. the successor of a running graph before it is published (see
+   #LINK - Hot-swap). Instead of compiling the whole graph again, the
+   topological order is maintained with the Pearce-Kelly algorithm, which only
+   reorders the gnodes between the two ends of an inserted edge, and the
+   levels and upward ranks are propagated from the touched gnodes only.
+   deps.required and the edge buffers are updated with each edge. The
+   readiness bitset and the partition are not updated: they must be built
+   after the mutations.
+
+   The work of a mutation is proportional to the gnodes it touches, not to
+   the size of the graph: the scratch arrays are kept in the graph and a
+   gnode is visited if its mark is the stamp of the current mutation, the
+   propagations pop the touched gnodes from a heap ordered by position,
+   graph->levels follows the number of gnodes in each level, and a deleted
+   gnode leaves a hole in the topological order, removed by
+   graph_order_compact() before the whole-graph passes that need a dense
+   order.
+ */
 
-/*ANCHOR - runner: implementation */
-int runner(void *arg)
-{
-  int *id = (int *)arg;
-  gnode_t *gnode;
+/* SECTION - Functions */
 
-  LOG_RUNNER_LIFECYCLE ? printf("runner %d start\n", *id) : 0;
-  atomic_fetch_add(&runners_count, 1);
+/*ANCHOR - mutation: grow */
+/* Size the arrays indexed by gnode id like graph->nodes; the entries from
+   'capacity' on are new. */
+void impl_mutation_grow(graph_t *graph, int capacity)
+{
+  size_t count = graph->capacity - capacity;
+
+  graph->level_count = mrealloc(graph->level_count, sizeof(int) * graph->capacity);
+  memset(graph->level_count + capacity, 0, sizeof(int) * count);
+  graph->mark = mrealloc(graph->mark, sizeof(int) * graph->capacity);
+  memset(graph->mark + capacity, 0, sizeof(int) * count);
+  graph->work = mrealloc(graph->work, sizeof(gnode_t *) * graph->capacity);
+  graph->found = mrealloc(graph->found, sizeof(gnode_t *) * graph->capacity);
+  graph->positions = mrealloc(graph->positions, sizeof(int) * graph->capacity);
+}
 
-  while (runners_active)
+/*ANCHOR - mutation: stamp */
+/* A new stamp: no gnode is marked with it yet */
+int impl_mutation_stamp(graph_t *graph)
+{
+  if (graph->stamp == INT_MAX)
   {
-    /* wait for new pending tasks */
-    lock(&tasks_queue_mtx);
-    while (tasks_queue_length == 0)
-      wait(&tasks_queue_cvar, &tasks_queue_mtx);
+    memset(graph->mark, 0, sizeof(int) * graph->capacity);
+    graph->stamp = 0;
+  }
+  return ++graph->stamp;
+}
 
-    if (!runners_active)
-    {
-      unlock(&tasks_queue_mtx);
-      goto exit;
-    }
+/*ANCHOR - mutation: worklist */
+/* Binary heap of gnodes by position, the first in topological order on top
+   if 'forward', the last otherwise */
+bool impl_mutation_before(gnode_t *a, gnode_t *b, bool forward)
+{
+  return forward ? a->position < b->position : a->position > b->position;
+}
 
-    /* get first pending task */
-    gnode = task_queue_pop_front();
-    unlock(&tasks_queue_mtx);
+void impl_mutation_push(graph_t *graph, gnode_t *gnode, bool forward)
+{
+  gnode_t **heap = graph->work;
+  int i = graph->work_length++;
 
-    /* execute task */
-    LOG_RUNNER_TASK ? printf("runner %d task %c\n", *id, gnode->label) : 0;
-    exec_trace_append(gnode->label);
-    (gnode->task)();
-    exec_trace_append(gnode->label);
+  for (; i > 0 && impl_mutation_before(gnode, heap[(i - 1) / 2], forward); i = (i - 1) / 2)
+    heap[i] = heap[(i - 1) / 2];
+  heap[i] = gnode;
+}
 
-    /* reset satisfied dependencies for next loop */
-    gnode->deps.satisfied = 0;
+gnode_t *impl_mutation_pop(graph_t *graph, bool forward)
+{
+  gnode_t **heap = graph->work;
+  gnode_t *top = heap[0], *last = heap[--graph->work_length];
+  int i = 0, length = graph->work_length;
 
-    if (gnode->label == 'Z')
-      runner_check_loops();
-    else
-      runner_process_children(gnode);
+  while (2 * i + 1 < length)
+  {
+    int child = 2 * i + 1;
+    if (child + 1 < length && impl_mutation_before(heap[child + 1], heap[child], forward))
+      child++;
+    if (!impl_mutation_before(heap[child], last, forward))
+      break;
+    heap[i] = heap[child];
+    i = child;
   }
+  heap[i] = last;
+  return top;
+}
 
-exit:
-  LOG_RUNNER_LIFECYCLE ? printf("runner %d exit\n", *id) : 0;
-  return 0;
+/*ANCHOR - mutation: level count */
+/* Move the gnode to another level, keeping graph->levels up to date. The
+   levels in use are contiguous from 0: a gnode of level l has a parent of
+   level l - 1. */
+void impl_mutation_level_set(gnode_t *gnode, int level)
+{
+  graph_t *graph = gnode->graph;
+
+  graph->level_count[gnode->level]--;
+  graph->level_count[level]++;
+  gnode->level = level;
+  if (level + 1 > graph->levels)
+    graph->levels = level + 1;
+  while (graph->levels > 1 && graph->level_count[graph->levels - 1] == 0)
+    graph->levels--;
 }
 
-/*ANCHOR - runner: check loops */
-void runner_check_loops()
+/*ANCHOR - mutation: levels */
+/* Propagate a level change downwards, in topological order */
+void impl_mutation_levels(gnode_t *gnode)
 {
-  LOG_EXEC_TRACE ? printf("exec trace: %s\n", exec_trace) : 0;
-  if (graph_loop == graph_loops)
-  {
-    /* stop graph execution */
-    printf("%d loops, stop runners\n", graph_loop);
-    runners_active = false;
-    tasks_queue_length = -1;
-    broadcast(&tasks_queue_cvar);
-  }
-  else
+  graph_t *graph = gnode->graph;
+  int stamp = impl_mutation_stamp(graph);
+
+  graph->mark[gnode->id] = stamp;
+  impl_mutation_push(graph, gnode, true);
+  while (graph->work_length > 0)
   {
-    /* loop over the graph */
-    exec_trace_reset();
-    task_queue_push_back(graph);
+    gnode_t *node = impl_mutation_pop(graph, true);
+    int level = 0;
+
+    for (lnode_t *parent = node->parents; parent != NULL; parent = parent->next)
+      if (parent->gnode->level + 1 > level)
+        level = parent->gnode->level + 1;
+    if (level == node->level)
+      continue;
+
+    impl_mutation_level_set(node, level);
+    for (lnode_t *child = node->children; child != NULL; child = child->next)
+      if (graph->mark[child->gnode->id] != stamp)
+      {
+        graph->mark[child->gnode->id] = stamp;
+        impl_mutation_push(graph, child->gnode, true);
+      }
   }
 }
 
-/*ANCHOR - runner: process children */
-void runner_process_children(gnode_t *gnode)
+/*ANCHOR - mutation: ranks */
+/* Propagate a rank change upwards, in reverse topological order */
+void impl_mutation_ranks(gnode_t *gnode)
 {
-  /* update children dependencies; if met, append child to task queue */
-  lnode_t *child = gnode->children;
-  while (child != NULL)
+  graph_t *graph = gnode->graph;
+  int stamp = impl_mutation_stamp(graph);
+
+  graph->mark[gnode->id] = stamp;
+  impl_mutation_push(graph, gnode, false);
+  while (graph->work_length > 0)
   {
-    lock(&child->gnode->mutex);
-    {
-      if (child->gnode->deps.required == ++child->gnode->deps.satisfied)
-        task_queue_push_back(child->gnode);
-    }
-    unlock(&child->gnode->mutex);
-    child = child->next;
+    gnode_t *node = impl_mutation_pop(graph, false);
+    long rank = 0;
+
+    for (lnode_t *child = node->children; child != NULL; child = child->next)
+      if (child->gnode->rank > rank)
+        rank = child->gnode->rank;
+    rank += node->cost;
+    if (rank == node->rank)
+      continue;
+
+    node->rank = rank;
+    for (lnode_t *parent = node->parents; parent != NULL; parent = parent->next)
+      if (graph->mark[parent->gnode->id] != stamp)
+      {
+        graph->mark[parent->gnode->id] = stamp;
+        impl_mutation_push(graph, parent->gnode, false);
+      }
   }
 }
 
-/*ANCHOR - runners: init pool */
-void runners_init_pool(int size)
+/*ANCHOR - mutation: compare positions */
+int impl_mutation_compare(const void *a, const void *b)
 {
-  runners_pool_size = size;
-  runners_pool = mcalloc(sizeof(thrd_t) * runners_pool_size);
-  runners_id = (int **)mcalloc(sizeof(int *) * runners_pool_size);
-  atomic_init(&runners_count, 0);
+  return (*(gnode_t *const *)a)->position - (*(gnode_t *const *)b)->position;
+}
 
-  for (int i = 0; i < runners_pool_size; i++)
+int impl_mutation_compare_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/*ANCHOR - mutation: search */
+/* Depth-first search from gnode, forwards (children) or backwards (parents),
+   of the gnodes with a position in [low, high] not yet marked with 'stamp'.
+   Returns the number of gnodes found, or -1 if 'target' is found.
+ */
+int impl_mutation_search(gnode_t *gnode, bool forward, int low, int high,
+                         gnode_t *target, int stamp, gnode_t **found)
+{
+  graph_t *graph = gnode->graph;
+  gnode_t **stack = graph->work;
+  int length = 0, count = 0;
+
+  stack[length++] = gnode;
+  graph->mark[gnode->id] = stamp;
+  while (length > 0)
   {
-    runners_id[i] = (int *)mcalloc(sizeof(int));
-    *runners_id[i] = i;
-    LOG_RUNNER_LIFECYCLE ? printf("runner %d create\n", i) : 0;
-    if (thrd_create(&runners_pool[i], &runner, (void *)runners_id[i]) != thrd_success)
-      exit(EXIT_FAILURE);
+    gnode_t *node = stack[--length];
+    found[count++] = node;
+    for (lnode_t *next = forward ? node->children : node->parents; next != NULL;
+         next = next->next)
+    {
+      if (next->gnode == target)
+        return -1;
+      if (graph->mark[next->gnode->id] != stamp && next->gnode->position >= low &&
+          next->gnode->position <= high)
+      {
+        graph->mark[next->gnode->id] = stamp;
+        stack[length++] = next->gnode;
+      }
+    }
   }
 
-  while (atomic_load(&runners_count) != runners_pool_size)
-    ;
+  return count;
 }
 
-/*ANCHOR - runners: loop */
-/* Run the task graph the specified number of loops */
-void runners_loop(int loops)
+/*ANCHOR - mutation: reorder */
+/* Pearce-Kelly: before the edge parent --> child is inserted with the child
+   before the parent in the topological order, the gnodes reachable from the
+   child and the gnodes that reach the parent, within the affected region,
+   are moved so that the latter come first. Only the positions in the region
+   are reused. Returns false if the edge would create a cycle.
+ */
+bool impl_mutation_reorder(gnode_t *parent, gnode_t *child)
 {
-  graph_loops = loops;
-  task_queue_push_back(graph);
+  graph_t *graph = parent->graph;
+  gnode_t **nodes = graph->found;
+  int *positions = graph->positions;
+  int stamp = impl_mutation_stamp(graph);
+  int forward, backward;
+
+  forward = impl_mutation_search(child, true, child->position, parent->position,
+                                 parent, stamp, nodes);
+  if (forward < 0 || child == parent)
+    return false;
+  backward = impl_mutation_search(parent, false, child->position, parent->position,
+                                  NULL, stamp, nodes + forward);
+
+  /* ancestors of the parent first, then descendants of the child */
+  qsort(nodes, forward, sizeof(gnode_t *), impl_mutation_compare);
+  qsort(nodes + forward, backward, sizeof(gnode_t *), impl_mutation_compare);
+  for (int i = 0; i < forward + backward; i++)
+    positions[i] = nodes[i]->position;
+  qsort(positions, forward + backward, sizeof(int), impl_mutation_compare_int);
+
+  for (int i = 0; i < backward; i++)
+    nodes[forward + i]->position = positions[i];
+  for (int i = 0; i < forward; i++)
+    nodes[i]->position = positions[backward + i];
+  for (int i = 0; i < forward + backward; i++)
+    graph->order[nodes[i]->position] = nodes[i];
+
+  return true;
 }
 
-/*ANCHOR - runners: join */
-void runners_join(void)
+/*ANCHOR - mutation: check */
+/* The buffers of a planned graph can't change, see #LINK - Memory planner */
+void impl_mutation_check(graph_t *graph)
 {
-  for (int i = 0; i < runners_pool_size; i++)
-    thrd_join(runners_pool[i], NULL);
+  if (graph->arena != NULL)
+  {
+    fprintf(stderr, "Error in graph %s: planned graphs can't be mutated\n",
+            graph->name);
+    exit(EXIT_FAILURE);
+  }
 }
 
-/*!SECTION - Functions */
-/*!SECTION - Pool of runners */
-#pragma endregion
+/*ANCHOR - mutation: compact order */
+/* Remove the holes left in the topological order by the deleted gnodes */
+void graph_order_compact(graph_t *graph)
+{
+  int length = 0;
 
-/* SECTION - Tasks implementation */
-#pragma region
-/*****************************************************************************
- *
- *                            TASKS IMPLEMENTATION
- *
- *****************************************************************************/
+  for (int i = 0; i < graph->order_length; i++)
+    if (graph->order[i] != NULL)
+    {
+      graph->order[length] = graph->order[i];
+      graph->order[length]->position = length;
+      length++;
+    }
+  graph->order_length = length;
+}
 
-/*ANCHOR - task: initial (A) */
-void task_A(void)
+/*ANCHOR - mutation: insert node */
+/* The new gnode has no edges yet: the graph is valid again once it has been
+   linked to a parent. */
+gnode_t *graph_node_insert(graph_t *graph, char label, task_fn_t task)
 {
-  LOG_LOOPS ? printf("-- start of loop\n") : 0;
-  graph_loop++;
+  gnode_t *gnode;
+
+  impl_mutation_check(graph);
+  gnode = gnode_new(graph, label, task);
+  if (graph->order != NULL)
+  {
+    /* compact the order once at least half of it is holes */
+    if (graph->order_length == graph->order_capacity)
+    {
+      if (2 * (graph->order_length - graph->size + 1) >= graph->order_length)
+        graph_order_compact(graph);
+      else
+      {
+        graph->order_capacity *= 2;
+        graph->order = mrealloc(graph->order, sizeof(gnode_t *) * graph->order_capacity);
+      }
+    }
+    gnode->position = graph->order_length++;
+    gnode->rank = gnode->cost;
+    graph->order[gnode->position] = gnode;
+    graph->level_count[0]++;
+  }
+  if (graph->exec_trace != NULL)
+    graph->exec_trace = mrealloc(graph->exec_trace, 2 * graph->size + 1);
+  if (graph->incremental)
+  {
+    lock(&graph->dirty_mtx);
+    graph->dirty = mrealloc(graph->dirty, sizeof(gnode_t *) * graph->size);
+    graph->affected = mrealloc(graph->affected, sizeof(gnode_t *) * graph->size);
+    unlock(&graph->dirty_mtx);
+  }
+
+  return gnode;
 }
 
-/*ANCHOR - task: final (Z) */
-void task_Z(void)
+/*ANCHOR - mutation: insert edge */
+/* Link parent --> child. Returns false, and the graph is not changed, if the
+   edge would create a cycle.
+ */
+bool graph_edge_insert(gnode_t *parent, gnode_t *child)
 {
-  LOG_LOOPS ? printf("-- end of loop %d\n", graph_loop) : 0;
-}
+  graph_t *graph = parent->graph;
+  lnode_t *lnode;
 
-/*ANCHOR - tasks: macro generator */
-#define GENERATE_TASK(NAME, MS)                            \
-  void task_##NAME(void)                                   \
-  {                                                        \
-    int nsec = MS * 1000000;                               \
-    if (TASK_JITTER)                                       \
-      nsec += (1 - rand() % 3) * (rand() % (nsec / 10));   \
-    struct timespec time = {.tv_sec = 0, .tv_nsec = nsec}; \
-    thrd_sleep(&time, NULL);                               \
+  impl_mutation_check(graph);
+  if (graph->order == NULL)
+  {
+    gnode_child(parent, child);
+    return true;
   }
+  if (parent->position >= child->position && !impl_mutation_reorder(parent, child))
+    return false;
 
-/*ANCHOR - tasks: instantiation */
-GENERATE_TASK(a, 100);
-GENERATE_TASK(b, 200);
-GENERATE_TASK(c, 100);
-GENERATE_TASK(1, 20);
-GENERATE_TASK(2, 50);
-GENERATE_TASK(3, 50);
-GENERATE_TASK(4, 100);
-GENERATE_TASK(i, 100);
-GENERATE_TASK(j, 80);
-GENERATE_TASK(k, 50);
-GENERATE_TASK(x, 50);
-GENERATE_TASK(y, 100);
+  gnode_child(parent, child);
+  for (lnode = parent->children; lnode->next != NULL; lnode = lnode->next)
+    ;
+  lnode->edge->size = parent->payload;
+  if (lnode->edge->size > 0)
+    lnode->edge->buffer = mcalloc(lnode->edge->size);
 
-/*!SECTION - Tasks implementation */
-#pragma endregion
+  impl_mutation_levels(child);
+  impl_mutation_ranks(parent);
+  return true;
+}
 
-/*SECTION - Main function */
-int main(void)
+/*ANCHOR - mutation: delete edge */
+/* Unlink parent --> child. The topological order remains valid. Returns false
+   if there is no such edge.
+ */
+bool graph_edge_delete(gnode_t *parent, gnode_t *child)
 {
-  /*ANCHOR - Loops and Runners */
-  int loops = 10;
-  int runners = 5;
-  gnode_t *gnode, *end;
+  lnode_t **lnode, *next;
+  edge_t *edge;
+
+  impl_mutation_check(parent->graph);
+  for (lnode = &parent->children; *lnode != NULL; lnode = &(*lnode)->next)
+    if ((*lnode)->gnode == child)
+      break;
+  if (*lnode == NULL)
+    return false;
+  edge = (*lnode)->edge;
+  next = (*lnode)->next;
+  free(*lnode);
+  *lnode = next;
+
+  for (lnode = &child->parents; (*lnode)->edge != edge; lnode = &(*lnode)->next)
+    ;
+  next = (*lnode)->next;
+  free(*lnode);
+  *lnode = next;
 
-  srand(time(NULL));
+  free(edge->buffer);
+  free(edge);
+  child->deps.required--;
 
-  /*ANCHOR - Graph creation */
-  /* Initial and final nodes */
-  graph = gnode_new('A', task_A);
-  end = gnode_new('Z', task_Z);
+  if (parent->graph->order != NULL)
+  {
+    impl_mutation_levels(child);
+    impl_mutation_ranks(parent);
+  }
+  return true;
+}
 
-  /* A --> { a, b, c } */
-  gnode_child_new(graph, 'a', task_a);
-  gnode_child_new(graph, 'b', task_b);
-  gnode_child_new(graph, 'c', task_c);
+/*ANCHOR - mutation: delete delay edge */
+void impl_mutation_undelay(edge_t *edge)
+{
+  lnode_t **lnode, *next;
 
-  /* a --> { 1, 2 } */
-  gnode = gnode_get(graph, 'a');
-  gnode_child_new(gnode, '1', task_1);
-  gnode_child_new(gnode, '2', task_2);
+  for (lnode = &edge->parent->delays_out; (*lnode)->edge != edge; lnode = &(*lnode)->next)
+    ;
+  next = (*lnode)->next;
+  free(*lnode);
+  *lnode = next;
 
-  /* b --> { 2 } */
-  gnode = gnode_get(graph, 'b');
-  gnode_child(gnode, gnode_get(graph, '2'));
+  for (lnode = &edge->child->delays_in; (*lnode)->edge != edge; lnode = &(*lnode)->next)
+    ;
+  next = (*lnode)->next;
+  free(*lnode);
+  *lnode = next;
 
-  /* c -> { 3, 4 } */
-  gnode = gnode_get(graph, 'c');
-  gnode_child_new(gnode, '3', task_3);
-  gnode_child_new(gnode, '4', task_4);
+  free(edge);
+}
 
-  /* 1 --> { i, j } */
-  gnode = gnode_get(graph, '1');
-  gnode_child_new(gnode, 'i', task_i);
-  gnode_child_new(gnode, 'j', task_j);
+/*ANCHOR - mutation: delete node */
+/* Delete the gnode and all its edges. The last gnode of the graph takes the
+   id of the deleted one, so the ids stay in [0, graph->size) without holes
+   and the arrays indexed by id only have to shrink. The root and the final
+   gnode 'Z' (graph->end in incremental mode) can't be deleted.
+ */
+void graph_node_delete(gnode_t *gnode)
+{
+  graph_t *graph = gnode->graph;
+  gnode_t *last;
 
-  /* 2 --> { k } */
-  gnode = gnode_get(graph, '2');
-  gnode_child_new(gnode, 'k', task_k);
+  if (gnode == graph->root)
+  {
+    fprintf(stderr, "Error in graph %s: the root can't be deleted\n", graph->name);
+    exit(EXIT_FAILURE);
+  }
+  if (gnode == graph->end || gnode->label == 'Z')
+  {
+    fprintf(stderr, "Error in graph %s: the end node can't be deleted\n", graph->name);
+    exit(EXIT_FAILURE);
+  }
 
-  /* 3 --> { k } */
-  gnode = gnode_get(graph, '3');
-  gnode_child(gnode, gnode_get(graph, 'k'));
+  while (gnode->children != NULL)
+    graph_edge_delete(gnode, gnode->children->gnode);
+  while (gnode->parents != NULL)
+    graph_edge_delete(gnode->parents->gnode, gnode);
+  while (gnode->delays_out != NULL)
+    impl_mutation_undelay(gnode->delays_out->edge);
+  while (gnode->delays_in != NULL)
+    impl_mutation_undelay(gnode->delays_in->edge);
 
-  /* 4 --> { Z } */
-  gnode = gnode_get(graph, '4');
-  gnode_child(gnode, end);
+  if (graph->order != NULL)
+  {
+    graph->order[gnode->position] = NULL;
+    while (graph->order[graph->order_length - 1] == NULL)
+      graph->order_length--;
+    impl_mutation_level_set(gnode, 0);
+    graph->level_count[0]--;
+  }
 
-  /* i --> { x } */
-  gnode = gnode_get(graph, 'i');
-  gnode_child_new(gnode, 'x', task_x);
+  if (gnode->dirty)
+  {
+    lock(&graph->dirty_mtx);
+    for (int i = 0; i < graph->dirty_count; i++)
+      if (graph->dirty[i] == gnode)
+        graph->dirty[i] = graph->dirty[--graph->dirty_count];
+    unlock(&graph->dirty_mtx);
+  }
 
-  /* j --> { x, y } */
-  gnode = gnode_get(graph, 'j');
-  gnode_child(gnode, gnode_get(graph, 'x'));
-  gnode_child_new(gnode, 'y', task_y);
+  last = graph->nodes[--graph->size];
+  graph->nodes[gnode->id] = last;
+  last->id = gnode->id;
 
-  /* k --> { y } */
-  gnode = gnode_get(graph, 'k');
-  gnode_child(gnode, gnode_get(graph, 'y'));
+  mtx_destroy(&gnode->mutex);
+  free(gnode);
+}
 
-  /* x --> { Z } */
-  gnode = gnode_get(graph, 'x');
-  gnode_child(gnode, end);
+/*ANCHOR - mutation: cost */
+/* Set the estimated duration of the task and update the upward ranks */
+void gnode_cost(gnode_t *gnode, long cost)
+{
+  gnode->cost = cost;
+  if (gnode->graph->order != NULL)
+    impl_mutation_ranks(gnode);
+}
 
-  /* y --> { Z } */
-  gnode = gnode_get(graph, 'y');
-  gnode_child(gnode, end);
+/*!SECTION - Functions */
+/*!SECTION - Graph mutation */
+#pragma endregion
 
-  /* Print graph */
-  gnode_print(graph);
+/* SECTION - Memory planner */
+#pragma region
+/*****************************************************************************
+ *
+ *                    EDGE BUFFERS MEMORY PLANNER
+ *
+ *****************************************************************************/
 
-  /*ANCHOR - Tasks queue init */
-  tasks_queue_init();
+/* By default each edge has its own buffer for the whole run, so memory grows
+   with the number of edges. The planner packs the buffers in a single arena
+   and reuses the offsets of buffers that can't be live at the same time. As
+   the runners follow no fixed schedule, a buffer is live from the start of
+   its producer to the end of its consumer in any valid execution, and two
+   buffers may share memory only when the consumer of one is an ancestor of
+   the producer of the other. Ancestors are found with reachability bitsets
+   computed in reverse topological order.
+
+   The outputs of clean gnodes must survive between loops in incremental
+   mode, so the planner can't be used with it; the graph must not be mutated
+   after planning.
+ */
 
-  /*ANCHOR - Runners init */
-  runners_init_pool(runners);
+/* SECTION - Types */
 
-  /*ANCHOR - Execution trace init */
-  exec_trace_init();
+/*ANCHOR - arena: buffer */
+typedef struct
+{
+  edge_t *edge;
+  size_t size;               /* rounded up to a cache line */
+  size_t offset;             /* in the arena */
+} arena_buffer_t;
+/*!SECTION - Types */
 
-  /*ANCHOR - Runners start */
-  runners_loop(loops);
+/* SECTION - Functions */
 
-  /*ANCHOR - Runners join */
-  runners_join();
+/*ANCHOR - arena: compare sizes */
+/* Larger buffers first, then by topological order of the producer */
+int impl_arena_compare(const void *a, const void *b)
+{
+  const arena_buffer_t *x = (const arena_buffer_t *)a;
+  const arena_buffer_t *y = (const arena_buffer_t *)b;
+
+  if (x->size != y->size)
+    return x->size < y->size ? 1 : -1;
+  return x->edge->parent->position - y->edge->parent->position;
+}
+
+/*ANCHOR - arena: compare offsets */
+int impl_arena_compare_offset(const void *a, const void *b)
+{
+  const arena_buffer_t *x = *(arena_buffer_t *const *)a;
+  const arena_buffer_t *y = *(arena_buffer_t *const *)b;
+
+  return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+/*ANCHOR - arena: reachability */
+/* Bitset of the descendants of each gnode, 'words' per gnode */
+uint64_t *impl_arena_reach(graph_t *graph, int words)
+{
+  uint64_t *reach = mcalloc(sizeof(uint64_t) * words * graph->size);
+
+  graph_order_compact(graph);
+  for (int i = graph->size - 1; i >= 0; i--)
+  {
+    gnode_t *gnode = graph->order[i];
+    uint64_t *descendants = reach + (size_t)words * gnode->id;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    {
+      uint64_t *grandchildren = reach + (size_t)words * child->gnode->id;
+      descendants[child->gnode->id / 64] |= (uint64_t)1 << (child->gnode->id % 64);
+      for (int w = 0; w < words; w++)
+        descendants[w] |= grandchildren[w];
+    }
+  }
+
+  return reach;
+}
+
+/*ANCHOR - arena: plan */
+/* Assign an offset to each edge buffer, first fit in decreasing size order,
+   and move the buffers to the arena. Reports the arena size versus the naive
+   layout.
+ */
+void arena_plan(graph_t *graph)
+{
+  int words = (graph->size + 63) / 64;
+  uint64_t *reach = impl_arena_reach(graph, words);
+  arena_buffer_t *buffers = NULL;
+  arena_buffer_t **placed;
+  int count = 0;
+  size_t naive = 0;
+
+  if (graph->incremental)
+  {
+    fprintf(stderr, "Error in graph %s: incremental graphs can't be planned\n",
+            graph->name);
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+      if (child->edge->size > 0)
+      {
+        buffers = mrealloc(buffers, sizeof(arena_buffer_t) * (count + 1));
+        buffers[count].edge = child->edge;
+        buffers[count].size = (child->edge->size + 63) & ~(size_t)63;
+        buffers[count].offset = 0;
+        naive += child->edge->size;
+        count++;
+      }
+  qsort(buffers, count, sizeof(arena_buffer_t), impl_arena_compare);
+
+  /* buffers live at the same time can't overlap */
+  placed = mcalloc(sizeof(arena_buffer_t *) * (count + 1));
+  graph->arena_size = 0;
+  for (int i = 0; i < count; i++)
+  {
+    arena_buffer_t *buffer = &buffers[i];
+    int conflicts = 0;
+
+    for (int j = 0; j < i; j++)
+    {
+      gnode_t *producer = buffer->edge->parent, *consumer = buffer->edge->child;
+      gnode_t *other_producer = buffers[j].edge->parent;
+      gnode_t *other_consumer = buffers[j].edge->child;
+      uint64_t *before = reach + (size_t)words * other_consumer->id;
+      uint64_t *after = reach + (size_t)words * consumer->id;
+
+      if (!(before[producer->id / 64] & ((uint64_t)1 << (producer->id % 64))) &&
+          !(after[other_producer->id / 64] & ((uint64_t)1 << (other_producer->id % 64))))
+        placed[conflicts++] = &buffers[j];
+    }
+    qsort(placed, conflicts, sizeof(arena_buffer_t *), impl_arena_compare_offset);
+
+    for (int j = 0; j < conflicts; j++)
+    {
+      if (buffer->offset + buffer->size <= placed[j]->offset)
+        break;
+      if (placed[j]->offset + placed[j]->size > buffer->offset)
+        buffer->offset = placed[j]->offset + placed[j]->size;
+    }
+    if (buffer->offset + buffer->size > graph->arena_size)
+      graph->arena_size = buffer->offset + buffer->size;
+  }
+
+  graph->arena = mcalloc(graph->arena_size > 0 ? graph->arena_size : 1);
+  for (int i = 0; i < count; i++)
+  {
+    free(buffers[i].edge->buffer);
+    buffers[i].edge->buffer = graph->arena + buffers[i].offset;
+  }
+
+  printf("%s: arena of %zu KiB for %d buffers, %zu KiB without reuse\n",
+         graph->name, graph->arena_size >> 10, count, naive >> 10);
+
+  free(placed);
+  free(buffers);
+  free(reach);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Memory planner */
+#pragma endregion
+
+/* SECTION - Queue of tasks */
+#pragma region
+/*****************************************************************************
+ *
+ *                   TASKS QUEUE DEFINITION AND MANAGEMENT
+ *
+ *****************************************************************************/
+
+/* SECTION - Variables */
+
+/*ANCHOR - task queue: length */
+/* Total number of gnodes in the queues of all registered graphs */
+int tasks_queue_length = 0;
+
+/*ANCHOR - task queue: next graph */
+/* Graph whose queue is checked first in the next pop (deficit round-robin) */
+int tasks_queue_next = 0;
+
+/*ANCHOR - task queue: groups */
+/* Runners are split in groups (runner id % groups). A runner takes first the
+   tasks whose gnode group is the group of the runner (the affinity hint set
+   by #LINK - partition: multilevel), and only then tasks of other groups. */
+int tasks_queue_groups = 1;
+
+/*ANCHOR - task queue: mutex */
+mtx_t tasks_queue_mtx;
+
+/*ANCHOR - task queue: cond var */
+cnd_t tasks_queue_cvar;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - tasks queue: init */
+void tasks_queue_init()
+{
+  tasks_queue_length = 0;
+  tasks_queue_next = 0;
+  mutex_init(&tasks_queue_mtx);
+  cvar_init(&tasks_queue_cvar);
+}
+
+/*ANCHOR - tasks queue: pop front */
+/* Graphs are scheduled in two levels:
+     - strict priority: only graphs of the most urgent class (lowest priority
+       value) with pending tasks are served
+     - deficit round-robin: within the class, each graph can be served up to
+       'weight' tasks per round; then the next graph is served
+   A graph loses its remaining deficit when its queue becomes empty, so idle
+   graphs do not accumulate credit. In the queue of the graph, the first task
+   with affinity to the group of the runner is taken; if there is none, the
+   runner steals the first task.
+ */
+gnode_t *task_queue_pop_front(int group)
+{
+  /* must be called right after the wait on the tasks_queue_cvar, with the
+  tasks_queue_mtx locked */
+  graph_t *graph = NULL;
+  int priority = INT_MAX;
+
+  for (int i = 0; i < graphs_count; i++)
+    if (graphs[i]->queue_length > 0 && graphs[i]->priority < priority)
+      priority = graphs[i]->priority;
+
+  while (graph == NULL)
+  {
+    for (int i = 0; i < graphs_count; i++)
+    {
+      graph_t *candidate = graphs[(tasks_queue_next + i) % graphs_count];
+      if (candidate->priority == priority && candidate->queue_length > 0 &&
+          candidate->deficit > 0)
+      {
+        graph = candidate;
+        break;
+      }
+    }
+
+    /* new round: all graphs in the class with pending tasks get credit */
+    if (graph == NULL)
+      for (int i = 0; i < graphs_count; i++)
+        if (graphs[i]->priority == priority && graphs[i]->queue_length > 0)
+          graphs[i]->deficit += graphs[i]->weight;
+  }
+
+  lnode_t **prev = &graph->queue;
+
+  if (tasks_queue_groups > 1)
+  {
+    while (*prev != NULL && (*prev)->gnode->group % tasks_queue_groups != group)
+      prev = &(*prev)->next;
+    if (*prev == NULL)
+    {
+      prev = &graph->queue;
+      graph->stolen++;
+    }
+  }
+
+  lnode_t *lnode = *prev;
+  gnode_t *gnode = lnode->gnode;
+
+  *prev = lnode->next;
+  graph->queue_length--;
+  tasks_queue_length--;
+  free(lnode);
+
+  graph->deficit--;
+  if (graph->queue_length == 0)
+    graph->deficit = 0;
+  tasks_queue_next = graph->deficit > 0 ? graph->id : (graph->id + 1) % graphs_count;
+
+  return gnode;
+}
+
+/*ANCHOR - task queue: push back */
+void task_queue_push_back(gnode_t *gnode)
+{
+  graph_t *graph = gnode->graph;
+
+  lock(&tasks_queue_mtx);
+  {
+    if (graph->queue == NULL)
+      graph->queue = lnode_new(gnode);
+    else
+      lnode_append(graph->queue, gnode);
+    graph->queue_length++;
+    tasks_queue_length++;
+  }
+  unlock(&tasks_queue_mtx);
+  cvar_broadcast(&tasks_queue_cvar);
+}
+/*!SECTION - Functions */
+/*!SECTION - Queue os tasks */
+#pragma endregion
+
+/* SECTION - Execution time & trace */
+#pragma region
+/*****************************************************************************
+ *
+ *                        EXECUTION TIME AND TRACE
+ *
+ *****************************************************************************/
+
+/* SECTION - Types */
+
+/*ANCHOR - exec time: type */
+/* The result of 'end - start' is the duration time of a graph loop, in ns.
+   Each graph keeps one sample per loop.
+ */
+struct exec_time
+{
+  long start;
+  long end;
+};
+
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - exec trace: global var */
+/* An execution trace is a sequence of characters (node labels) indicating the
+start and end of a graph node. It is used to check the validity of a graph
+loop, in which no child starts before all parents have finished. For example,
+if 'A --> a', then a valid trace cannot contain '..A..a..A..'; the trace must
+be like '..A..A..a..'. There is a trace per graph loop, kept in the graph
+(see #LINK - graph: struct).
+*/
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - exec time: init */
+/* Depends on the number of loops: must be called before running the graph */
+void exec_time_init(graph_t *graph)
+{
+  graph->exec_time = mcalloc(sizeof(exec_time_t) * graph->loops);
+}
+
+/*ANCHOR - exec time: compare */
+int impl_exec_time_compare(const void *a, const void *b)
+{
+  long x = *(const long *)a;
+  long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+/*ANCHOR - exec time: print */
+/* Latency statistics of the loops of a graph, in ms */
+void exec_time_print(graph_t *graph)
+{
+  if (!LOG_LATENCY || graph->loop == 0)
+    return;
+
+  int n = graph->loop;
+  long *latency = mcalloc(sizeof(long) * n);
+  double mean = 0;
+
+  for (int i = 0; i < n; i++)
+  {
+    latency[i] = graph->exec_time[i].end - graph->exec_time[i].start;
+    mean += latency[i];
+  }
+  qsort(latency, n, sizeof(long), impl_exec_time_compare);
+  mean /= n;
+
+  printf("%s: priority %d weight %d latency ms: mean %.2f p50 %.2f p99 %.2f "
+         "max %.2f\n",
+         graph->name, graph->priority, graph->weight, mean / 1e6,
+         latency[(n - 1) / 2] / 1e6, latency[(99 * (n - 1)) / 100] / 1e6,
+         latency[n - 1] / 1e6);
+  free(latency);
+}
+
+/*ANCHOR - exec trace: init */
+/* Depends on the graph size: must be called after the graph has been created.
+ */
+void exec_trace_init(graph_t *graph)
+{
+  graph->exec_trace = mcalloc(sizeof(char) * (2 * graph->size + 1));
+  mutex_init(&graph->exec_trace_mtx);
+}
+
+void exec_trace_reset(graph_t *graph)
+{
+  graph->exec_trace[0] = 0;
+}
+
+/*ANCHOR - exec trace: append */
+void exec_trace_append(graph_t *graph, char label)
+{
+  int i = 0;
+  lock(&graph->exec_trace_mtx);
+  {
+    while (graph->exec_trace[i] != 0)
+      i++;
+    graph->exec_trace[i] = label;
+    graph->exec_trace[i + 1] = 0;
+  }
+  unlock(&graph->exec_trace_mtx);
+}
+
+/*!SECTION - Functions */
+
+/*!SECTION - Execution time & trace */
+#pragma endregion
+
+/* SECTION - Readiness bitset */
+#pragma region
+/*****************************************************************************
+ *
+ *                            READINESS BITSET
+ *
+ *****************************************************************************/
+
+/* With the deps_t counters, each edge costs a lock and an update of the
+   counter of the child, and all the parents of a child with a high fan-in
+   contend on the same counter. With the readiness bitset:
+     - a finished gnode sets its bit in the 'done' bitset of the graph: a
+       single atomic update, whatever the number of children
+     - a child is ready when all the bits of its parents are set in 'done':
+       '(parents & ~done) == 0', a test-for-zero on packed bitmasks that is
+       vectorised with AVX2 or AVX-512 when available
+     - a ready child is enqueued by the runner that sets its bit in 'claimed'
+   The parents mask of a child only spans the 64-bit words that contain its
+   parents, which for graphs built level by level are the words of the
+   previous level. The vectorised test only applies to parents spanning at
+   least 4 (AVX2) or 8 (AVX-512) words, i.e. fan-ins of a few hundred
+   gnodes; narrower masks take the scalar path. 'done' is updated with
+   atomic operations while the children are tested: the scalar test reads it
+   with relaxed atomic loads, the vector loads read aligned 64-bit lanes that
+   are not torn on x86-64.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - bitset: struct */
+struct bitset
+{
+  int words;           /* 64-bit words per bitset: ceil(graph size / 64) */
+  uint64_t *done;      /* gnodes finished in the current loop */
+  uint64_t *claimed;   /* gnodes enqueued in the current loop */
+  uint64_t **parents;  /* parents mask of each gnode, from word 'first' */
+  int *first;          /* first word of the parents mask of each gnode */
+  int *length;         /* words of the parents mask of each gnode */
+};
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - bitset: ready test */
+/* Selected at runtime: scalar, AVX2 or AVX-512 */
+bool (*bitset_ready_impl)(const uint64_t *parents, const uint64_t *done, int words);
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - bitset: ready test (scalar) */
+bool impl_bitset_ready_scalar(const uint64_t *parents, const uint64_t *done, int words)
+{
+  for (int i = 0; i < words; i++)
+    if (parents[i] & ~__atomic_load_n(&done[i], __ATOMIC_RELAXED))
+      return false;
+  return true;
+}
+
+#if defined(__x86_64__)
+/*ANCHOR - bitset: ready test (avx2) */
+__attribute__((target("avx2"))) bool
+impl_bitset_ready_avx2(const uint64_t *parents, const uint64_t *done, int words)
+{
+  int i = 0;
+
+  for (; i + 4 <= words; i += 4)
+  {
+    __m256i p = _mm256_loadu_si256((const __m256i *)(parents + i));
+    __m256i d = _mm256_loadu_si256((const __m256i *)(done + i));
+    /* testc: (~d & p) == 0 */
+    if (!_mm256_testc_si256(d, p))
+      return false;
+  }
+  return impl_bitset_ready_scalar(parents + i, done + i, words - i);
+}
+
+/*ANCHOR - bitset: ready test (avx-512) */
+__attribute__((target("avx512f"))) bool
+impl_bitset_ready_avx512(const uint64_t *parents, const uint64_t *done, int words)
+{
+  int i = 0;
+
+  for (; i + 8 <= words; i += 8)
+  {
+    __m512i p = _mm512_loadu_si512((const void *)(parents + i));
+    __m512i d = _mm512_loadu_si512((const void *)(done + i));
+    __m512i pending = _mm512_andnot_si512(d, p);
+    if (_mm512_test_epi64_mask(pending, pending) != 0)
+      return false;
+  }
+  return impl_bitset_ready_scalar(parents + i, done + i, words - i);
+}
+#endif
+
+/*ANCHOR - bitset: init */
+/* Use the readiness bitset instead of the deps_t counters in the graph */
+void bitset_init(graph_t *graph)
+{
+  bitset_t *bitset = mcalloc(sizeof(bitset_t));
+
+  bitset->words = (graph->size + 63) / 64;
+  bitset->done = mcalloc(sizeof(uint64_t) * bitset->words);
+  bitset->claimed = mcalloc(sizeof(uint64_t) * bitset->words);
+  bitset->parents = mcalloc(sizeof(uint64_t *) * graph->size);
+  bitset->first = mcalloc(sizeof(int) * graph->size);
+  bitset->length = mcalloc(sizeof(int) * graph->size);
+
+  for (int i = 0; i < graph->size; i++)
+  {
+    int first = bitset->words, last = 0;
+
+    for (lnode_t *parent = graph->nodes[i]->parents; parent != NULL; parent = parent->next)
+    {
+      int word = parent->gnode->id / 64;
+      first = word < first ? word : first;
+      last = word > last ? word : last;
+    }
+    if (first > last)
+      first = last = 0;
+
+    bitset->first[i] = first;
+    bitset->length[i] = last - first + 1;
+    bitset->parents[i] = mcalloc(sizeof(uint64_t) * bitset->length[i]);
+    for (lnode_t *parent = graph->nodes[i]->parents; parent != NULL; parent = parent->next)
+      bitset->parents[i][parent->gnode->id / 64 - first] |= 1UL << (parent->gnode->id % 64);
+  }
+
+  bitset_ready_impl = impl_bitset_ready_scalar;
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx512f"))
+    bitset_ready_impl = impl_bitset_ready_avx512;
+  else if (__builtin_cpu_supports("avx2"))
+    bitset_ready_impl = impl_bitset_ready_avx2;
+#endif
+
+  graph->bitset = bitset;
+}
+
+/*ANCHOR - bitset: reset */
+/* At the start of each loop */
+void bitset_reset(graph_t *graph)
+{
+  memset(graph->bitset->done, 0, sizeof(uint64_t) * graph->bitset->words);
+  memset(graph->bitset->claimed, 0, sizeof(uint64_t) * graph->bitset->words);
+}
+
+/*ANCHOR - bitset: release */
+/* Mark the gnode as finished and enqueue its ready children. Of all the
+   parents of a child, at least the last one to finish sees all the bits set
+   in 'done'; if several parents see the child ready, 'claimed' ensures it is
+   enqueued once.
+ */
+void task_queue_push_back(gnode_t *gnode);
+
+void bitset_release(gnode_t *gnode)
+{
+  bitset_t *bitset = gnode->graph->bitset;
+
+  __atomic_fetch_or(&bitset->done[gnode->id / 64], 1UL << (gnode->id % 64), __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+  {
+    int id = child->gnode->id;
+    uint64_t bit = 1UL << (id % 64);
+
+    if (bitset_ready_impl(bitset->parents[id], bitset->done + bitset->first[id],
+                          bitset->length[id]) &&
+        !(__atomic_fetch_or(&bitset->claimed[id / 64], bit, __ATOMIC_SEQ_CST) & bit))
+      task_queue_push_back(child->gnode);
+  }
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Readiness bitset */
+#pragma endregion
+
+/* SECTION - Incremental execution */
+#pragma region
+/*****************************************************************************
+ *
+ *                  INCREMENTAL EXECUTION OF CHANGED GNODES
+ *
+ *****************************************************************************/
+
+/* In incremental mode a loop only runs the gnodes marked dirty since the
+   previous loop (e.g. by a source whose input has changed) and their
+   descendants, plus 'Z' to end the loop. Clean gnodes keep the output of the
+   last time they ran in their edge buffers, and the dependencies on clean
+   parents are satisfied before the loop starts. The work per loop is
+   proportional to the affected gnodes and their edges, except for the
+   bitset engine, which also sets all words of the bitsets.
+ */
+
+/* SECTION - Variables */
+
+/*ANCHOR - incremental: changes */
+/* Number of random gnodes changed before each loop by the simulated source,
+   -1 to run all gnodes in each loop */
+int incremental_changes = -1;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - incremental: mark dirty */
+/* The gnode will run in the next loop, with all its descendants */
+void gnode_dirty(gnode_t *gnode)
+{
+  graph_t *graph = gnode->graph;
+
+  lock(&graph->dirty_mtx);
+  if (!gnode->dirty)
+  {
+    gnode->dirty = true;
+    graph->dirty[graph->dirty_count++] = gnode;
+  }
+  unlock(&graph->dirty_mtx);
+}
+
+/*ANCHOR - incremental: init */
+/* Run the graph in incremental mode. The first loop runs all the gnodes. */
+void incremental_init(graph_t *graph)
+{
+  graph->incremental = true;
+  graph->dirty = mcalloc(sizeof(gnode_t *) * graph->size);
+  graph->dirty_count = 0;
+  graph->affected = mcalloc(sizeof(gnode_t *) * graph->size);
+  graph->affected_count = 0;
+  graph->affected_total = 0;
+  mutex_init(&graph->dirty_mtx);
+
+  for (int i = 0; i < graph->size; i++)
+    if (graph->nodes[i]->label == 'Z')
+      graph->end = graph->nodes[i];
+  gnode_dirty(graph->root);
+}
+
+/*ANCHOR - incremental: loop start */
+/* Find the gnodes affected by the changes, satisfy their dependencies on
+   clean parents and enqueue those that are ready.
+ */
+void incremental_loop_start(graph_t *graph)
+{
+  gnode_t **affected = graph->affected;
+  int count = 0, ready = 0;
+
+  for (int i = 0; i < graph->affected_count; i++)
+    affected[i]->affected = false;
+
+  if (incremental_changes > 0)
+    for (int i = 0; i < incremental_changes; i++)
+    {
+      gnode_t *gnode = graph->nodes[random_next() % graph->size];
+      if (gnode != graph->end)
+        gnode_dirty(gnode);
+    }
+
+  /* dirty gnodes and their descendants, breadth first */
+  lock(&graph->dirty_mtx);
+  for (int i = 0; i < graph->dirty_count; i++)
+  {
+    graph->dirty[i]->dirty = false;
+    if (!graph->dirty[i]->affected)
+    {
+      graph->dirty[i]->affected = true;
+      affected[count++] = graph->dirty[i];
+    }
+  }
+  graph->dirty_count = 0;
+  unlock(&graph->dirty_mtx);
+
+  for (int i = 0; i < count; i++)
+    for (lnode_t *child = affected[i]->children; child != NULL; child = child->next)
+      if (!child->gnode->affected)
+      {
+        child->gnode->affected = true;
+        affected[count++] = child->gnode;
+      }
+  if (!graph->end->affected)
+  {
+    graph->end->affected = true;
+    affected[count++] = graph->end;
+  }
+  graph->affected_count = count;
+  graph->affected_total += count;
+
+  /* clean parents have already finished; the ready gnodes are moved to the
+     front, as their counters change once they are enqueued */
+  for (int i = 0; i < count; i++)
+  {
+    affected[i]->deps.satisfied = 0;
+    for (lnode_t *parent = affected[i]->parents; parent != NULL; parent = parent->next)
+      if (!parent->gnode->affected)
+        affected[i]->deps.satisfied++;
+    if (affected[i]->deps.satisfied == affected[i]->deps.required)
+    {
+      gnode_t *gnode = affected[ready];
+      affected[ready++] = affected[i];
+      affected[i] = gnode;
+    }
+  }
+  if (graph->bitset != NULL)
+  {
+    memset(graph->bitset->done, 0xff, sizeof(uint64_t) * graph->bitset->words);
+    memset(graph->bitset->claimed, 0xff, sizeof(uint64_t) * graph->bitset->words);
+    for (int i = 0; i < count; i++)
+    {
+      uint64_t bit = ~((uint64_t)1 << (affected[i]->id % 64));
+      graph->bitset->done[affected[i]->id / 64] &= bit;
+      if (affected[i]->deps.satisfied < affected[i]->deps.required)
+        graph->bitset->claimed[affected[i]->id / 64] &= bit;
+    }
+  }
+
+  /* once all dependencies are set, as the tasks may start right away */
+  for (int i = 0; i < ready; i++)
+    task_queue_push_back(affected[i]);
+}
+
+/*ANCHOR - incremental: print */
+void incremental_print(graph_t *graph)
+{
+  printf("%s: %.1f of %d tasks run per loop (incremental)\n", graph->name,
+         (double)graph->affected_total / graph->loop, graph->size);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Incremental execution */
+#pragma endregion
+
+/* SECTION - Payload handles */
+#pragma region
+/*****************************************************************************
+ *
+ *                 REFERENCE-COUNTED PAYLOADS FOR FAN-OUT
+ *
+ *****************************************************************************/
+
+/* Instead of writing its output in the buffer of each edge to its children,
+   a gnode can write it once in an immutable payload shared by all of them:
+   fan-out costs a pointer per edge, whatever the size of the payload. The
+   payload counts the children that have not consumed it yet, and returns to
+   a pool of power-of-two size classes when the last one finishes. Released
+   payloads are first kept in a small cache of the runner, so that most
+   allocations don't touch the global pool.
+
+   The outputs are released once consumed, so shared payloads can't be used
+   in incremental mode nor with the memory planner.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - payload: struct */
+struct payload
+{
+  atomic_int refs;           /* edges not yet consumed */
+  int class;                 /* size class, 64 << class bytes */
+  struct payload *next;      /* in the pool */
+  char data[];
+};
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - payload: pool */
+/* Free payloads of each size class */
+payload_t *payload_pool[32];
+mtx_t payload_pool_mtx;
+
+/*ANCHOR - payload: runner cache */
+_Thread_local payload_t *payload_cache[32];
+_Thread_local int payload_cached[32];
+int payload_cache_size = 8; /* max payloads per class in each runner */
+
+/*ANCHOR - payload: statistics */
+atomic_long payload_allocated; /* payloads allocated from the system */
+atomic_long payload_reused;    /* payloads taken from the pool or the cache */
+atomic_long payload_shared;    /* edges served without a copy */
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - payload: init */
+void payload_init(void)
+{
+  mutex_init(&payload_pool_mtx);
+  atomic_init(&payload_allocated, 0);
+  atomic_init(&payload_reused, 0);
+  atomic_init(&payload_shared, 0);
+}
+
+/*ANCHOR - payload: graph */
+/* Share the outputs of the gnodes of the graph, instead of the edge buffers */
+void payload_graph(graph_t *graph)
+{
+  if (graph->incremental || graph->arena != NULL)
+  {
+    fprintf(stderr, "Error in graph %s: payloads can't be shared\n", graph->name);
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+    {
+      free(child->edge->buffer);
+      child->edge->buffer = NULL;
+    }
+  graph->payloads = true;
+}
+
+/*ANCHOR - payload: new */
+payload_t *payload_new(size_t size)
+{
+  payload_t *payload = NULL;
+  int class = 0;
+
+  while ((size_t)64 << class < size)
+    class++;
+
+  if (payload_cached[class] > 0)
+  {
+    payload = payload_cache[class];
+    payload_cache[class] = payload->next;
+    payload_cached[class]--;
+  }
+  else
+  {
+    lock(&payload_pool_mtx);
+    if (payload_pool[class] != NULL)
+    {
+      payload = payload_pool[class];
+      payload_pool[class] = payload->next;
+    }
+    unlock(&payload_pool_mtx);
+  }
+
+  if (payload != NULL)
+    atomic_fetch_add(&payload_reused, 1);
+  else
+  {
+    payload = mcalloc(sizeof(payload_t) + ((size_t)64 << class));
+    payload->class = class;
+    atomic_fetch_add(&payload_allocated, 1);
+  }
+  return payload;
+}
+
+/*ANCHOR - payload: release */
+/* Called by each consumer; the last one returns the payload to the pool */
+void payload_release(payload_t *payload)
+{
+  int class = payload->class;
+
+  if (atomic_fetch_sub(&payload->refs, 1) != 1)
+    return;
+
+  if (payload_cached[class] < payload_cache_size)
+  {
+    payload->next = payload_cache[class];
+    payload_cache[class] = payload;
+    payload_cached[class]++;
+  }
+  else
+  {
+    lock(&payload_pool_mtx);
+    payload->next = payload_pool[class];
+    payload_pool[class] = payload;
+    unlock(&payload_pool_mtx);
+  }
+}
+
+/*ANCHOR - payload: flush */
+/* Return the payloads cached by the runner to the pool, before it exits.
+   Without cached payloads the pool, maybe not initialised, isn't touched. */
+void payload_flush(void)
+{
+  for (int class = 0; class < 32; class++)
+  {
+    if (payload_cached[class] == 0)
+      continue;
+    lock(&payload_pool_mtx);
+    while (payload_cached[class] > 0)
+    {
+      payload_t *payload = payload_cache[class];
+      payload_cache[class] = payload->next;
+      payload_cached[class]--;
+      payload->next = payload_pool[class];
+      payload_pool[class] = payload;
+    }
+    unlock(&payload_pool_mtx);
+  }
+}
+
+/*ANCHOR - payload: share */
+/* Attach a new payload to all the edges to the children of the gnode.
+   Returns the memory to write the output, or NULL if there is no output.
+ */
+void *payload_share(gnode_t *gnode)
+{
+  payload_t *payload;
+  int edges = 0;
+
+  for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    if (child->edge->size > 0)
+      edges++;
+  if (edges == 0)
+    return NULL;
+
+  payload = payload_new(gnode->payload);
+  atomic_store(&payload->refs, edges);
+  for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    if (child->edge->size > 0)
+    {
+      child->edge->payload = payload;
+      child->edge->buffer = payload->data;
+    }
+  atomic_fetch_add(&payload_shared, edges);
+
+  return payload->data;
+}
+
+/*ANCHOR - payload: release inputs */
+/* Called once the gnode has consumed its inputs */
+void payload_release_inputs(gnode_t *gnode)
+{
+  for (lnode_t *parent = gnode->parents; parent != NULL; parent = parent->next)
+    if (parent->edge->payload != NULL)
+    {
+      payload_t *payload = parent->edge->payload;
+      parent->edge->payload = NULL;
+      parent->edge->buffer = NULL;
+      payload_release(payload);
+    }
+}
+
+/*ANCHOR - payload: print */
+void payload_print(void)
+{
+  printf("payloads: %ld allocated, %ld reused, %ld edges shared without copy\n",
+         atomic_load(&payload_allocated), atomic_load(&payload_reused),
+         atomic_load(&payload_shared));
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Payload handles */
+#pragma endregion
+
+/* SECTION - Memoisation */
+#pragma region
+/*****************************************************************************
+ *
+ *                 CONTENT-ADDRESSED MEMOISATION OF TASKS
+ *
+ *****************************************************************************/
+
+/* The output of a task that is a pure function of its inputs can be reused
+   when the inputs repeat. For the gnodes that opt in, the input edge buffers
+   are hashed before the task runs; on a hit the task is skipped and the
+   stored output is copied to the edges to the children. The cache is shared
+   by all graphs and bounded in bytes, with LRU eviction. It can be backed by
+   an append-only file mapped in memory, loaded at startup, so that it
+   survives restarts.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - memo: entry */
+typedef struct memo_entry
+{
+  uint64_t key;              /* hash of the gnode and its inputs */
+  size_t size;
+  void *data;                /* output of the task */
+  int pins;                  /* hits copying the data, with the mutex unlocked */
+  bool evicted;              /* freed by the last unpin */
+  struct memo_entry *next;   /* next entry in the same bucket */
+  struct memo_entry *older;  /* LRU list */
+  struct memo_entry *newer;
+} memo_entry_t;
+
+/*ANCHOR - memo: store */
+/* Header of the file, followed by records and their data, 8-byte aligned */
+typedef struct
+{
+  uint64_t magic;
+  uint64_t version;          /* layout of the records */
+  uint64_t capacity;         /* bytes of the file */
+  uint64_t length;           /* bytes used after the header */
+} memo_store_t;
+
+typedef struct
+{
+  uint64_t key;
+  uint64_t size;
+} memo_record_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - memo: hash table */
+memo_entry_t **memo_buckets;
+int memo_buckets_count = 4096;
+
+/*ANCHOR - memo: LRU list */
+memo_entry_t *memo_newest = NULL;
+memo_entry_t *memo_oldest = NULL;
+
+/*ANCHOR - memo: capacity */
+size_t memo_capacity = 1 << 20; /* max bytes of stored outputs */
+size_t memo_used = 0;
+long memo_evicted = 0;
+
+/*ANCHOR - memo: file */
+memo_store_t *memo_store = NULL;
+size_t memo_store_size = 64L << 20;
+uint64_t memo_store_magic = 0x4f4d454d48504147; /* "GAPHMEMO" */
+uint64_t memo_store_version = 1;
+
+/*ANCHOR - memo: mutex */
+mtx_t memo_mtx;
+
+/*ANCHOR - memo: hash primes */
+const uint64_t memo_primes[5] = {0x9E3779B185EBCA87ULL, 0xC2B2AE3D27D4EB4FULL,
+                                 0x165667B19E3779F9ULL, 0x85EBCA77C2B2AE63ULL,
+                                 0x27D4EB2F165667C5ULL};
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - memo: hash round */
+uint64_t impl_memo_round(uint64_t acc, uint64_t input)
+{
+  acc += input * memo_primes[1];
+  acc = (acc << 31) | (acc >> 33);
+  return acc * memo_primes[0];
+}
+
+/*ANCHOR - memo: hash */
+/* Non-cryptographic hash in the style of xxHash64: four independent lanes
+   consume 32 bytes per iteration, so their multiply-rotate rounds overlap in
+   the pipeline or are vectorised by the compiler, and are merged at the end.
+ */
+uint64_t memo_hash(const void *data, size_t size, uint64_t seed)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint64_t lanes[4] = {seed + memo_primes[0] + memo_primes[1], seed + memo_primes[1],
+                       seed, seed - memo_primes[0]};
+  uint64_t hash, word;
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32)
+    for (int lane = 0; lane < 4; lane++)
+    {
+      memcpy(&word, bytes + i + 8 * lane, sizeof(word));
+      lanes[lane] = impl_memo_round(lanes[lane], word);
+    }
+
+  hash = ((lanes[0] << 1) | (lanes[0] >> 63)) + ((lanes[1] << 7) | (lanes[1] >> 57)) +
+         ((lanes[2] << 12) | (lanes[2] >> 52)) + ((lanes[3] << 18) | (lanes[3] >> 46));
+  hash += size;
+
+  for (; i + 8 <= size; i += 8)
+  {
+    memcpy(&word, bytes + i, sizeof(word));
+    hash ^= impl_memo_round(0, word);
+    hash = ((hash << 27) | (hash >> 37)) * memo_primes[0] + memo_primes[3];
+  }
+  for (; i < size; i++)
+  {
+    hash ^= bytes[i] * memo_primes[4];
+    hash = ((hash << 11) | (hash >> 53)) * memo_primes[0];
+  }
+
+  hash ^= hash >> 33;
+  hash *= memo_primes[1];
+  hash ^= hash >> 29;
+  hash *= memo_primes[2];
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/*ANCHOR - memo: key */
+/* Graph name and label are used instead of ids, as they are stable across
+   restarts and hot-swaps. */
+uint64_t memo_key(gnode_t *gnode, int loop)
+{
+  uint64_t key = memo_hash(gnode->graph->name, strlen(gnode->graph->name),
+                           (uint64_t)gnode->label);
+
+  for (lnode_t *parent = gnode->parents; parent != NULL; parent = parent->next)
+    if (parent->edge->size > 0)
+      key = memo_hash(edge_buffer(parent->edge, loop), parent->edge->size, key);
+
+  return key;
+}
+
+/*ANCHOR - memo: LRU unlink */
+/* with the memo mutex locked */
+void impl_memo_unlink(memo_entry_t *entry)
+{
+  if (entry->older != NULL)
+    entry->older->newer = entry->newer;
+  else
+    memo_oldest = entry->newer;
+  if (entry->newer != NULL)
+    entry->newer->older = entry->older;
+  else
+    memo_newest = entry->older;
+}
+
+/*ANCHOR - memo: LRU push */
+/* with the memo mutex locked */
+void impl_memo_push(memo_entry_t *entry)
+{
+  entry->older = memo_newest;
+  entry->newer = NULL;
+  if (memo_newest != NULL)
+    memo_newest->newer = entry;
+  else
+    memo_oldest = entry;
+  memo_newest = entry;
+}
+
+/*ANCHOR - memo: find */
+/* with the memo mutex locked */
+memo_entry_t *impl_memo_find(uint64_t key)
+{
+  memo_entry_t *entry = memo_buckets[key % memo_buckets_count];
+
+  while (entry != NULL && entry->key != key)
+    entry = entry->next;
+  return entry;
+}
+
+/*ANCHOR - memo: free */
+/* with the memo mutex locked */
+void impl_memo_free(memo_entry_t *entry)
+{
+  free(entry->data);
+  free(entry);
+}
+
+/*ANCHOR - memo: evict */
+/* Remove the least recently used entry, with the memo mutex locked. A pinned
+   entry is only unlinked: the last hit copying its data frees it. */
+void impl_memo_evict(void)
+{
+  memo_entry_t *entry = memo_oldest;
+  memo_entry_t **bucket = &memo_buckets[entry->key % memo_buckets_count];
+
+  while (*bucket != entry)
+    bucket = &(*bucket)->next;
+  *bucket = entry->next;
+  impl_memo_unlink(entry);
+
+  memo_used -= entry->size;
+  memo_evicted++;
+  if (entry->pins > 0)
+    entry->evicted = true;
+  else
+    impl_memo_free(entry);
+}
+
+/*ANCHOR - memo: insert */
+/* with the memo mutex locked; returns false if the output is already stored
+   or doesn't fit in the cache */
+bool impl_memo_insert(uint64_t key, const void *data, size_t size)
+{
+  memo_entry_t *entry;
+
+  if (size > memo_capacity || impl_memo_find(key) != NULL)
+    return false;
+
+  entry = mcalloc(sizeof(memo_entry_t));
+  entry->key = key;
+  entry->size = size;
+  entry->data = mcalloc(size > 0 ? size : 1);
+  if (size > 0)
+    memcpy(entry->data, data, size);
+  entry->next = memo_buckets[key % memo_buckets_count];
+  memo_buckets[key % memo_buckets_count] = entry;
+  impl_memo_push(entry);
+
+  memo_used += size;
+  while (memo_used > memo_capacity)
+    impl_memo_evict();
+  return true;
+}
+
+/*ANCHOR - memo: persist */
+/* Append the entry to the file, if there is room; with the memo mutex
+   locked */
+void impl_memo_persist(uint64_t key, const void *data, size_t size)
+{
+  size_t length = sizeof(memo_record_t) + ((size + 7) & ~(size_t)7);
+  memo_record_t *record;
+
+  if (sizeof(memo_store_t) + memo_store->length + length > memo_store_size)
+    return;
+
+  record = (memo_record_t *)((char *)(memo_store + 1) + memo_store->length);
+  record->key = key;
+  record->size = size;
+  memcpy(record + 1, data, size);
+  memo_store->length += length;
+}
+
+/*ANCHOR - memo: store check */
+/* The store is only loaded if its header matches this build and all its
+   records lie within the bytes the file had when it was opened; a truncated
+   or corrupt store would otherwise be read out of bounds */
+bool impl_memo_store_valid(size_t file_size)
+{
+  size_t length;
+
+  if (file_size < sizeof(memo_store_t) || memo_store->magic != memo_store_magic ||
+      memo_store->version != memo_store_version ||
+      memo_store->capacity != memo_store_size ||
+      memo_store->length > file_size - sizeof(memo_store_t))
+    return false;
+
+  length = memo_store->length;
+  for (size_t offset = 0; offset < length;)
+  {
+    memo_record_t *record = (memo_record_t *)((char *)(memo_store + 1) + offset);
+    if (length - offset < sizeof(memo_record_t) ||
+        record->size > length - offset - sizeof(memo_record_t))
+      return false;
+    offset += sizeof(memo_record_t) + ((record->size + 7) & ~(size_t)7);
+    if (offset > length)
+      return false;
+  }
+  return true;
+}
+
+/*ANCHOR - memo: init */
+/* Cache of 'capacity' bytes, backed by the file at 'path' if not NULL */
+void memo_init(size_t capacity, const char *path)
+{
+  memo_capacity = capacity;
+  memo_buckets = mcalloc(sizeof(memo_entry_t *) * memo_buckets_count);
+  mutex_init(&memo_mtx);
+
+  if (path == NULL)
+    return;
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1 ||
+      ((size_t)st.st_size != memo_store_size && ftruncate(fd, memo_store_size) == -1))
+  {
+    fprintf(stderr, "Error in memo store %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  memo_store = mmap(NULL, memo_store_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (memo_store == MAP_FAILED)
+  {
+    fprintf(stderr, "Error in mmap\n");
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+
+  if (!impl_memo_store_valid((size_t)st.st_size))
+  {
+    if (st.st_size > 0)
+      printf("memo store %s: discarded, not a valid store\n", path);
+    memo_store->magic = memo_store_magic;
+    memo_store->version = memo_store_version;
+    memo_store->capacity = memo_store_size;
+    memo_store->length = 0;
+    return;
+  }
+
+  /* load the stored outputs, the newest are kept if they don't fit */
+  int entries = 0;
+  for (size_t offset = 0; offset < memo_store->length;)
+  {
+    memo_record_t *record = (memo_record_t *)((char *)(memo_store + 1) + offset);
+    impl_memo_insert(record->key, record + 1, record->size);
+    offset += sizeof(memo_record_t) + ((record->size + 7) & ~(size_t)7);
+    entries++;
+  }
+  printf("memo store %s: %d outputs loaded\n", path, entries);
+}
+
+/*ANCHOR - memo: enable */
+/* The task of the gnode must be a pure function of its inputs */
+void gnode_memo(gnode_t *gnode)
+{
+  if (gnode->parents == NULL)
+  {
+    fprintf(stderr, "Error in graph %s: node %c has no inputs to memoise\n",
+            gnode->graph->name, gnode->label);
+    exit(EXIT_FAILURE);
+  }
+  gnode->memo = true;
+}
+
+/*ANCHOR - memo: graph */
+/* Memoise all the gnodes with inputs, but 'Z' */
+void memo_graph(graph_t *graph)
+{
+  for (int i = 0; i < graph->size; i++)
+    if (graph->nodes[i]->parents != NULL && graph->nodes[i]->label != 'Z')
+      gnode_memo(graph->nodes[i]);
+}
+
+/*ANCHOR - memo: task */
+/* Run the task of the gnode, or reuse its stored output. The mutex is only
+   held to find the entry and pin it: the output is copied with the mutex
+   unlocked, so that hits on other runners don't wait for the copy, and a
+   pinned entry that is evicted meanwhile is freed after it.
+ */
+void memo_task(gnode_t *gnode, context_t *context)
+{
+  int loop = gnode->graph->loop;
+  uint64_t key = memo_key(gnode, loop);
+  memo_entry_t *entry;
+  lnode_t *output = gnode->children;
+
+  /* all the children receive the same output */
+  while (output != NULL && output->edge->size == 0)
+    output = output->next;
+  size_t size = output != NULL ? output->edge->size : 0;
+
+  lock(&memo_mtx);
+  entry = impl_memo_find(key);
+  /* an output of another size (a colliding key) is a miss, before a
+     payload of gnode->payload bytes is taken */
+  if (entry != NULL && entry->size != size)
+    entry = NULL;
+  if (entry != NULL)
+  {
+    impl_memo_unlink(entry);
+    impl_memo_push(entry);
+    entry->pins++;
+  }
+  unlock(&memo_mtx);
+
+  if (entry != NULL)
+  {
+    if (gnode->graph->payloads)
+    {
+      void *data = payload_share(gnode);
+      if (data != NULL)
+        memcpy(data, entry->data, size);
+    }
+    else
+      for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+        if (child->edge->size > 0)
+          memcpy(edge_buffer(child->edge, loop), entry->data, child->edge->size);
+    gnode->memo_hits++;
+
+    lock(&memo_mtx);
+    if (--entry->pins == 0 && entry->evicted)
+      impl_memo_free(entry);
+    unlock(&memo_mtx);
+    return;
+  }
+  gnode->memo_misses++;
+
+  task_run(gnode, context, loop);
+  gnode_output(gnode, loop);
+
+  lock(&memo_mtx);
+  if (output == NULL)
+    impl_memo_insert(key, NULL, 0);
+  else if (impl_memo_insert(key, edge_buffer(output->edge, loop), output->edge->size) &&
+           memo_store != NULL)
+    impl_memo_persist(key, edge_buffer(output->edge, loop), output->edge->size);
+  unlock(&memo_mtx);
+}
+
+/*ANCHOR - memo: print */
+void memo_print(graph_t *graph)
+{
+  for (int i = 0; i < graph->size; i++)
+    if (graph->nodes[i]->memo)
+      printf("%s: memo %c hits %ld misses %ld\n", graph->name,
+             graph->nodes[i]->label, graph->nodes[i]->memo_hits,
+             graph->nodes[i]->memo_misses);
+}
+
+/*ANCHOR - memo: print cache */
+void memo_print_cache(void)
+{
+  printf("memo cache: %zu of %zu KiB used, %ld outputs evicted\n", memo_used >> 10,
+         memo_capacity >> 10, memo_evicted);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Memoisation */
+#pragma endregion
+
+/* SECTION - Pool of runners */
+#pragma region
+/*****************************************************************************
+ *
+ *                    RUNNERS DEFINITION AND MANAGEMENT
+ *
+ *****************************************************************************/
+
+/* SECTION - Variables */
+
+/*ANCHOR - runners: active */
+bool runners_active = true;
+
+/*ANCHOR - runners: ids */
+int **runners_id;
+
+/*ANCHOR - runners: pool */
+thrd_t *runners_pool;
+
+/*ANCHOR - runners: pool_size */
+int runners_pool_size;
+
+/*ANCHOR - runners: count */
+atomic_int runners_count;
+
+/*ANCHOR - runners: overhead */
+/* When timed, each runner adds up its time outside the task bodies and the
+   waits for tasks (dispatch, release and queue), see #LINK - Benchmark harness */
+typedef struct
+{
+  _Alignas(64) long ns;
+  long tasks;
+} runner_time_t;
+
+bool runners_timed = false;
+runner_time_t *runners_time;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - runner: prototypes */
+/* Check finalization conditions*/
+void runner_check_loops(graph_t *graph);
+
+/* Start the next admitted frame, if any; see #LINK - Admission control */
+void admission_loop_end(graph_t *graph);
+
+/* Stop the frame source of a graph */
+void admission_close(graph_t *graph);
+
+/* Frames of external threads; see #LINK - Frame streams */
+extern int streams_count;
+extern atomic_int streams_handed;
+stream_t *stream_claim(void);
+void stream_next(stream_t *stream);
+void stream_result(gnode_t *gnode);
+void stream_loop_end(graph_t *graph, bool last);
+
+/* Enqueue ready-to-run child nodes */
+void runner_process_children(gnode_t *gnode);
+
+/* Wake up the runners to exit */
+void runners_stop(void);
+
+/* Replace the graph by its published successor; see #LINK - Hot-swap */
+graph_t *graph_swap(graph_t *graph);
+
+/* The runner starts or ends a task */
+extern atomic_long *rcu_epochs;
+void rcu_enter(int runner);
+void rcu_exit(int runner);
+void rcu_init(int runners);
+
+/*ANCHOR - runner: implementation */
+int runner(void *arg)
+{
+  int *id = (int *)arg;
+  gnode_t *gnode;
+  context_t context;
+
+  LOG_RUNNER_LIFECYCLE ? printf("runner %d start\n", *id) : 0;
+  context_init(&context, *id);
+  atomic_fetch_add(&runners_count, 1);
+
+  while (runners_active)
+  {
+    long start = runners_timed ? now_ns() : 0;
+    long waited = 0;
+
+    /* wait for new pending tasks, or frames handed over by the producers
+       of streams, which signal without the mutex: the timeout bounds a
+       missed signal */
+    lock(&tasks_queue_mtx);
+    while (tasks_queue_length == 0 && atomic_load(&streams_handed) == 0)
+    {
+      long wait = runners_timed ? now_ns() : 0;
+      if (streams_count > 0)
+        cvar_timedwait(&tasks_queue_cvar, &tasks_queue_mtx, STREAM_WAKEUP_NS);
+      else
+        cvar_wait(&tasks_queue_cvar, &tasks_queue_mtx);
+      waited += runners_timed ? now_ns() - wait : 0;
+    }
+
+    if (!runners_active)
+    {
+      unlock(&tasks_queue_mtx);
+      goto exit;
+    }
+
+    if (tasks_queue_length == 0)
+    {
+      /* start the loop of a frame handed over by a producer */
+      stream_t *stream = stream_claim();
+      rcu_enter(*id);
+      unlock(&tasks_queue_mtx);
+      if (stream != NULL)
+        stream_next(stream);
+      rcu_exit(*id);
+      continue;
+    }
+
+    /* get first pending task */
+    gnode = task_queue_pop_front(*id % tasks_queue_groups);
+    rcu_enter(*id);
+    unlock(&tasks_queue_mtx);
+
+    /* execute task */
+    LOG_RUNNER_TASK ? printf("runner %d task %c\n", *id, gnode->label) : 0;
+    exec_trace_append(gnode->graph, gnode->label);
+    long body = runners_timed ? now_ns() : 0;
+    if (gnode->memo)
+      memo_task(gnode, &context);
+    else
+    {
+      task_run(gnode, &context, gnode->graph->loop);
+      gnode_output(gnode, gnode->graph->loop);
+    }
+    body = runners_timed ? now_ns() - body : 0;
+    if (gnode->graph->stream != NULL && gnode->label == 'Z')
+      stream_result(gnode);
+    if (gnode->graph->payloads)
+      payload_release_inputs(gnode);
+    exec_trace_append(gnode->graph, gnode->label);
+
+    /* reset satisfied dependencies for next loop */
+    gnode->deps.satisfied = 0;
+
+    if (gnode->label == 'Z')
+      runner_check_loops(gnode->graph);
+    else
+      runner_process_children(gnode);
+
+    if (runners_timed)
+    {
+      runners_time[*id].ns += now_ns() - start - waited - body;
+      runners_time[*id].tasks++;
+    }
+
+    /* quiescent state: no references to the graph are held */
+    rcu_exit(*id);
+  }
+
+exit:
+  context_free(&context);
+  LOG_RUNNER_LIFECYCLE ? printf("runner %d exit\n", *id) : 0;
+  return 0;
+}
+
+/*ANCHOR - runner: loop start */
+/* Start a new loop of the graph. The latency of the loop is measured from
+   'start', the time the loop was triggered (e.g. arrival of a frame).
+ */
+void runner_loop_start(graph_t *graph, long start)
+{
+  graph->loop++;
+  LOG_LOOPS ? printf("-- %s start of loop %d\n", graph->name, graph->loop) : 0;
+  graph->exec_time[graph->loop - 1].start = start;
+  exec_trace_reset(graph);
+  if (graph->incremental)
+    incremental_loop_start(graph);
+  else
+  {
+    if (graph->bitset != NULL)
+      bitset_reset(graph);
+    task_queue_push_back(graph->root);
+  }
+}
+
+/*ANCHOR - runner: check loops */
+void runner_check_loops(graph_t *graph)
+{
+  graph->exec_time[graph->loop - 1].end = now_ns();
+  LOG_LOOPS ? printf("-- %s end of loop %d\n", graph->name, graph->loop) : 0;
+  LOG_EXEC_TRACE ? printf("%s exec trace: %s\n", graph->name, graph->exec_trace) : 0;
+  if (graph->stream != NULL)
+    stream_loop_end(graph, graph->loop == graph->loops);
+  if (graph->loop == graph->loops)
+  {
+    /* stop graph execution */
+    printf("%s: %d loops\n", graph->name, graph->loop);
+    if (graph->admission != NULL)
+      admission_close(graph);
+    if (atomic_fetch_add(&graphs_done, 1) + 1 == graphs_count)
+    {
+      /* all graphs done, stop runners */
+      printf("%d graphs, stop runners\n", graphs_count);
+      runners_stop();
+    }
+  }
+  else
+  {
+    /* loops in flight have finished: a published graph takes over */
+    graph = graph_swap(graph);
+    if (graph->admission != NULL)
+      /* loop over the graph when the next frame is admitted */
+      admission_loop_end(graph);
+    else if (graph->stream != NULL)
+      /* loop over the graph when the next frame is pushed */
+      stream_next(graph->stream);
+    else
+      /* loop over the graph */
+      runner_loop_start(graph, now_ns());
+  }
+}
+
+/*ANCHOR - runner: process children */
+void runner_process_children(gnode_t *gnode)
+{
+  long start = LOG_RELEASE ? now_ns() : 0;
+
+  if (gnode->graph->bitset != NULL)
+    bitset_release(gnode);
+  else
+  {
+    /* update children dependencies; if met, append child to task queue */
+    lnode_t *child = gnode->children;
+    while (child != NULL)
+    {
+      lock(&child->gnode->mutex);
+      {
+        if (child->gnode->deps.required == ++child->gnode->deps.satisfied)
+          task_queue_push_back(child->gnode);
+      }
+      unlock(&child->gnode->mutex);
+      child = child->next;
+    }
+  }
+
+  if (LOG_RELEASE)
+  {
+    int edges = 0;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+      edges++;
+    atomic_fetch_add(&gnode->graph->release_ns, now_ns() - start);
+    atomic_fetch_add(&gnode->graph->release_edges, edges);
+  }
+}
+
+/*ANCHOR - runner: release print */
+void runner_release_print(graph_t *graph)
+{
+  long edges = atomic_load(&graph->release_edges);
+
+  if (!LOG_RELEASE || edges == 0)
+    return;
+  printf("%s: release %.1f ns per edge (%s)\n", graph->name,
+         (double)atomic_load(&graph->release_ns) / edges,
+         graph->bitset != NULL ? "bitset" : "counters");
+}
+
+/*ANCHOR - runners: init pool */
+void runners_init_pool(int size)
+{
+  runners_pool_size = size;
+  runners_pool = mcalloc(sizeof(thrd_t) * runners_pool_size);
+  runners_id = (int **)mcalloc(sizeof(int *) * runners_pool_size);
+  runners_time = aligned_alloc(64, sizeof(runner_time_t) * runners_pool_size);
+  if (runners_time == NULL)
+  {
+    fprintf(stderr, "Error in aligned_alloc\n");
+    exit(EXIT_FAILURE);
+  }
+  memset(runners_time, 0, sizeof(runner_time_t) * runners_pool_size);
+  atomic_init(&runners_count, 0);
+  rcu_init(runners_pool_size);
+
+  for (int i = 0; i < runners_pool_size; i++)
+  {
+    runners_id[i] = (int *)mcalloc(sizeof(int));
+    *runners_id[i] = i;
+    LOG_RUNNER_LIFECYCLE ? printf("runner %d create\n", i) : 0;
+    if (thrd_create(&runners_pool[i], &runner, (void *)runners_id[i]) != thrd_success)
+      exit(EXIT_FAILURE);
+  }
+
+  while (atomic_load(&runners_count) != runners_pool_size)
+    ;
+}
+
+/*ANCHOR - runners: loop */
+/* Run all registered graphs the specified number of loops. Graphs with
+   admission control start their frame source instead.
+ */
+void admission_start(graph_t *graph);
+
+void runners_loop(int loops)
+{
+  atomic_init(&graphs_done, 0);
+  for (int i = 0; i < graphs_count; i++)
+  {
+    graphs[i]->loops = loops;
+    exec_time_init(graphs[i]);
+    if (graphs[i]->admission != NULL)
+      admission_start(graphs[i]);
+    else if (graphs[i]->stream != NULL)
+      /* the first pushed frame starts the first loop */
+      continue;
+    else
+      runner_loop_start(graphs[i], now_ns());
+  }
+}
+
+/*ANCHOR - runners: stop */
+void runners_stop(void)
+{
+  lock(&tasks_queue_mtx);
+  {
+    runners_active = false;
+    tasks_queue_length = -1;
+  }
+  unlock(&tasks_queue_mtx);
+  cvar_broadcast(&tasks_queue_cvar);
+}
+
+/*ANCHOR - runners: join */
+void runners_join(void)
+{
+  for (int i = 0; i < runners_pool_size; i++)
+    thrd_join(runners_pool[i], NULL);
+}
+
+/*ANCHOR - runners: free */
+/* Once joined, a new pool can be created */
+void runners_free(void)
+{
+  for (int i = 0; i < runners_pool_size; i++)
+    free(runners_id[i]);
+  free(runners_id);
+  free(runners_pool);
+  free(runners_time);
+  free(rcu_epochs);
+  runners_active = true;
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Pool of runners */
+#pragma endregion
+
+/* SECTION - Admission control */
+#pragma region
+/*****************************************************************************
+ *
+ *                    ADMISSION CONTROL AND BACKPRESSURE
+ *
+ *****************************************************************************/
+
+/* SECTION - Types */
+
+/*ANCHOR - admission: policy */
+/* What to do with a new frame when the queue of pending frames is full:
+     - drop oldest: discard the oldest pending frame, queue the new one
+     - drop newest: discard the new frame
+     - coalesce: the new frame replaces the newest pending frame
+     - block: the frame source waits until there is room in the queue
+ */
+typedef enum
+{
+  ADMIT_DROP_OLDEST,
+  ADMIT_DROP_NEWEST,
+  ADMIT_COALESCE,
+  ADMIT_BLOCK
+} admit_policy_t;
+
+/*ANCHOR - admission: frame */
+typedef struct
+{
+  long seq;   /* frame sequence number */
+  long time;  /* arrival time, in ns */
+  void *data; /* content of external frames, see #LINK - Frame streams */
+} frame_t;
+
+/*ANCHOR - admission: struct */
+/* A frame source offers frames every 'period' ms. A frame starts a loop if no
+   loop is in flight; otherwise it waits in a bounded queue of pending frames
+   and the policy is applied when the queue is full. Loops are not pipelined:
+   there is at most one loop in flight per graph.
+ */
+struct admission
+{
+  admit_policy_t policy;
+  int period;        /* frame period, in ms */
+  int capacity;      /* max number of pending frames */
+  frame_t *frames;   /* pending frames, circular buffer */
+  int head;          /* oldest pending frame */
+  int length;        /* number of pending frames */
+  int in_flight;     /* loops started and not yet finished */
+  bool closed;       /* the graph has completed all its loops */
+  long offered;      /* statistics: frames offered by the source */
+  long admitted;     /* frames that started a loop */
+  long dropped;      /* frames discarded */
+  long coalesced;    /* frames replaced by a newer one */
+  long blocked;      /* times the source had to wait */
+  graph_t *graph;    /* graph started by the frames, see #LINK - Hot-swap */
+  mtx_t mutex;
+  cnd_t cvar;        /* signaled when there is room in the queue */
+  thrd_t source;
+};
+/*!SECTION - Types */
+
+/* SECTION - Functions */
+
+/*ANCHOR - admission: constructor */
+admission_t *admission_new(admit_policy_t policy, int period, int capacity)
+{
+  admission_t *admission = (admission_t *)mcalloc(sizeof(admission_t));
+
+  admission->policy = policy;
+  admission->period = period;
+  admission->capacity = capacity;
+  admission->frames = mcalloc(sizeof(frame_t) * capacity);
+  admission->head = 0;
+  admission->length = 0;
+  admission->in_flight = 0;
+  admission->closed = false;
+  mutex_init(&admission->mutex);
+  cvar_init(&admission->cvar);
+
+  return admission;
+}
+
+/*ANCHOR - admission: policy from name */
+bool admission_policy(const char *name, admit_policy_t *policy)
+{
+  static const char *names[] = {"oldest", "newest", "coalesce", "block"};
+
+  for (int i = 0; i < 4; i++)
+    if (strcmp(name, names[i]) == 0)
+    {
+      *policy = (admit_policy_t)i;
+      return true;
+    }
+  return false;
+}
+
+/*ANCHOR - admission: push frame */
+/* with the admission mutex locked and room in the queue */
+void impl_admission_push(admission_t *admission, frame_t frame)
+{
+  int tail = (admission->head + admission->length) % admission->capacity;
+  admission->frames[tail] = frame;
+  admission->length++;
+}
+
+/*ANCHOR - admission: pop frame */
+/* with the admission mutex locked and pending frames */
+frame_t impl_admission_pop(admission_t *admission)
+{
+  frame_t frame = admission->frames[admission->head];
+  admission->head = (admission->head + 1) % admission->capacity;
+  admission->length--;
+  return frame;
+}
+
+/*ANCHOR - admission: offer */
+/* Offer a new frame to the graph. Returns false if the frame has been
+   discarded (drop newest) or the graph does not accept more frames.
+ */
+bool admission_offer(admission_t *admission, long seq)
+{
+  frame_t frame = {.seq = seq, .time = now_ns()};
+  bool start = false, accepted = true;
+  graph_t *graph;
+
+  lock(&admission->mutex);
+  {
+    graph = admission->graph;
+    admission->offered++;
+    if (admission->closed)
+      accepted = false;
+    else if (admission->in_flight == 0 && admission->length == 0)
+    {
+      admission->in_flight++;
+      admission->admitted++;
+      start = true;
+    }
+    else if (admission->length < admission->capacity)
+      impl_admission_push(admission, frame);
+    else
+      switch (admission->policy)
+      {
+      case ADMIT_DROP_OLDEST:
+        LOG_ADMISSION ? printf("%s: drop frame %ld\n", graph->name,
+                               admission->frames[admission->head].seq)
+                      : 0;
+        impl_admission_pop(admission);
+        impl_admission_push(admission, frame);
+        admission->dropped++;
+        break;
+      case ADMIT_DROP_NEWEST:
+        LOG_ADMISSION ? printf("%s: drop frame %ld\n", graph->name, seq) : 0;
+        admission->dropped++;
+        accepted = false;
+        break;
+      case ADMIT_COALESCE:
+      {
+        int newest = (admission->head + admission->length - 1) % admission->capacity;
+        LOG_ADMISSION ? printf("%s: coalesce frame %ld into %ld\n", graph->name,
+                               admission->frames[newest].seq, seq)
+                      : 0;
+        admission->frames[newest] = frame;
+        admission->coalesced++;
+        break;
+      }
+      case ADMIT_BLOCK:
+        LOG_ADMISSION ? printf("%s: block frame %ld\n", graph->name, seq) : 0;
+        admission->blocked++;
+        while (admission->length == admission->capacity && !admission->closed)
+          cvar_wait(&admission->cvar, &admission->mutex);
+        if (admission->closed)
+          accepted = false;
+        else
+          impl_admission_push(admission, frame);
+        break;
+      }
+  }
+  unlock(&admission->mutex);
+
+  if (start)
+    runner_loop_start(graph, frame.time);
+
+  return accepted;
+}
+
+/*ANCHOR - admission: loop end */
+/* Called by the runner at the end of a loop: start the oldest pending frame,
+   if any; otherwise there is no loop in flight.
+ */
+void admission_loop_end(graph_t *graph)
+{
+  admission_t *admission = graph->admission;
+  frame_t frame;
+  bool start = false;
+
+  lock(&admission->mutex);
+  {
+    if (admission->length > 0)
+    {
+      frame = impl_admission_pop(admission);
+      admission->admitted++;
+      start = true;
+    }
+    else
+      admission->in_flight--;
+  }
+  unlock(&admission->mutex);
+  cvar_signal(&admission->cvar);
+
+  if (start)
+    runner_loop_start(graph, frame.time);
+}
+
+/*ANCHOR - admission: pressure */
+/* Backpressure signal for the frame source: fraction of the admission
+   capacity (loop in flight plus queue of pending frames) in use. A value of
+   1.0 means the next frame will be dropped, coalesced or blocked.
+ */
+double admission_pressure(admission_t *admission)
+{
+  double pressure;
+
+  lock(&admission->mutex);
+  pressure = (double)(admission->in_flight + admission->length) /
+             (1 + admission->capacity);
+  unlock(&admission->mutex);
+
+  return pressure;
+}
+
+/*ANCHOR - admission: close */
+/* No more frames are accepted; a blocked source is released */
+void admission_close(graph_t *graph)
+{
+  admission_t *admission = graph->admission;
+
+  lock(&admission->mutex);
+  admission->closed = true;
+  unlock(&admission->mutex);
+  cvar_broadcast(&admission->cvar);
+}
+
+/*ANCHOR - admission: periodic source */
+/* Simulated frame source (e.g. a camera): offers a frame every period until
+   the graph is closed. When the source has been blocked, the next frame is
+   offered one period after the source is released.
+ */
+int impl_admission_source(void *arg)
+{
+  admission_t *admission = (admission_t *)arg;
+  long period = admission->period * 1000000L;
+  long next = now_ns();
+  long seq = 0;
+  bool closed = false;
+
+  while (!closed)
+  {
+    if (LOG_ADMISSION && admission_pressure(admission) >= 1.0)
+      printf("backpressure at frame %ld\n", seq);
+    admission_offer(admission, seq++);
+
+    next += period;
+    long now = now_ns();
+    if (next < now)
+      next = now;
+    struct timespec time = {.tv_sec = (next - now) / 1000000000L,
+                            .tv_nsec = (next - now) % 1000000000L};
+    thrd_sleep(&time, NULL);
+
+    lock(&admission->mutex);
+    closed = admission->closed;
+    unlock(&admission->mutex);
+  }
+
+  return 0;
+}
+
+/*ANCHOR - admission: start */
+void admission_start(graph_t *graph)
+{
+  graph->admission->graph = graph;
+  if (thrd_create(&graph->admission->source, &impl_admission_source,
+                  graph->admission) != thrd_success)
+    exit(EXIT_FAILURE);
+}
+
+/*ANCHOR - admission: join */
+void admission_join(graph_t *graph)
+{
+  thrd_join(graph->admission->source, NULL);
+}
+
+/*ANCHOR - admission: print */
+void admission_print(graph_t *graph)
+{
+  admission_t *admission = graph->admission;
+
+  printf("%s: frames offered %ld admitted %ld dropped %ld coalesced %ld "
+         "blocked %ld\n",
+         graph->name, admission->offered, admission->admitted,
+         admission->dropped, admission->coalesced, admission->blocked);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Admission control */
+#pragma endregion
+
+/* SECTION - Frame streams */
+#pragma region
+/*****************************************************************************
+ *
+ *                  EXTERNAL FRAME SOURCE AND SINK RINGS
+ *
+ *****************************************************************************/
+
+/* An external thread (e.g. a capture thread) pushes frames in the source
+   ring of a graph, and each frame starts a loop. At the end of each loop the
+   frame is pushed in the sink ring, from which another external thread
+   (e.g. an actuation thread) collects the results. Both are bounded
+   single-producer single-consumer rings: push and pop are wait-free, and
+   the indices of the producer and the consumer are in separate cache lines.
+
+   The consumer of the source ring is whoever starts the next loop. At the
+   end of a loop the runner pops the next frame; if there is none, the graph
+   is marked idle. The next push then hands the start of the loop over to the
+   runners: it sets a flag of the stream and signals them, without taking
+   the mutex of the tasks queue, and an idle runner pops the frame.
+
+   The data of a frame in the sink is the result of its loop: the inputs of
+   the final task Z, copied before they are released. The sink has a result
+   buffer more than frames, so the data of a popped frame is valid until
+   the next stream_pop. The result is only copied if the sink has room for
+   its frame: when it is full, the buffer after the tail is the one of the
+   frame popped last, still read by the consumer, and the frame is lost.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - ring: struct */
+typedef struct
+{
+  _Alignas(64) atomic_size_t head; /* next frame to pop */
+  size_t tail_cache;               /* last tail seen by the consumer */
+  _Alignas(64) atomic_size_t tail; /* next frame to push */
+  size_t head_cache;               /* last head seen by the producer */
+  _Alignas(64) size_t mask;        /* capacity - 1, a power of two */
+  frame_t *frames;
+} ring_t;
+
+/*ANCHOR - stream: struct */
+struct stream
+{
+  _Atomic(graph_t *) graph; /* current graph, see #LINK - Hot-swap */
+  ring_t *source;     /* frames pushed by the producer */
+  ring_t *sink;       /* frames of the finished loops */
+  frame_t frame;      /* frame of the loop in flight */
+  atomic_bool idle;   /* no loop in flight, the next push starts one */
+  atomic_bool handed; /* the next loop is handed over to the runners */
+  char *results;      /* result buffers, one more than the sink frames */
+  bool room;          /* the sink has room for the frame of the loop in flight */
+  size_t size;        /* bytes of each result */
+  atomic_bool closed; /* all the loops have run */
+  long dropped;       /* frames the source ring had no room for */
+  long lost;          /* frames the sink ring had no room for */
+  /* simulated producer and consumer threads */
+  thrd_t producer;
+  thrd_t consumer;
+  long period;  /* between two pushed frames, in ns */
+  long pushed;  /* frames pushed by the producer */
+  long popped;  /* frames popped by the consumer */
+  long latency; /* sum of the push to pop latencies, in ns */
+};
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - streams: handed over */
+int streams_count = 0;          /* graphs with a stream, set before the runners */
+atomic_int streams_handed = 0;  /* loops handed over, not yet claimed */
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - ring: constructor */
+ring_t *ring_new(int capacity)
+{
+  ring_t *ring = aligned_alloc(64, sizeof(ring_t));
+  size_t size = 1;
+
+  if (ring == NULL)
+  {
+    fprintf(stderr, "Error in aligned_alloc\n");
+    exit(EXIT_FAILURE);
+  }
+  while (size < (size_t)capacity)
+    size <<= 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  ring->tail_cache = 0;
+  ring->head_cache = 0;
+  ring->mask = size - 1;
+  ring->frames = mcalloc(sizeof(frame_t) * size);
+
+  return ring;
+}
+
+/*ANCHOR - ring: push */
+/* Producer side. Returns false if the ring is full. */
+bool ring_push(ring_t *ring, frame_t frame)
+{
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  if (tail - ring->head_cache > ring->mask)
+  {
+    ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - ring->head_cache > ring->mask)
+      return false;
+  }
+  ring->frames[tail & ring->mask] = frame;
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+/*ANCHOR - ring: full */
+/* Producer side. Once false, stays false until the next push. */
+bool ring_full(ring_t *ring)
+{
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  if (tail - ring->head_cache > ring->mask)
+    ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return tail - ring->head_cache > ring->mask;
+}
+
+/*ANCHOR - ring: pop */
+/* Consumer side. Returns false if the ring is empty. */
+bool ring_pop(ring_t *ring, frame_t *frame)
+{
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+  if (head == ring->tail_cache)
+  {
+    ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == ring->tail_cache)
+      return false;
+  }
+  *frame = ring->frames[head & ring->mask];
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return true;
+}
+
+/*ANCHOR - ring: empty */
+bool ring_empty(ring_t *ring)
+{
+  return atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
+
+/*ANCHOR - stream: init */
+/* Loops of the graph are started by the frames of its source ring */
+void stream_init(graph_t *graph, int source, int sink)
+{
+  stream_t *stream = mcalloc(sizeof(stream_t));
+
+  stream->source = ring_new(source);
+  stream->sink = ring_new(sink);
+  atomic_init(&stream->idle, true);
+  atomic_init(&stream->handed, false);
+  atomic_init(&stream->closed, false);
+  atomic_init(&stream->graph, graph);
+
+  /* the inputs of Z, the payloads of its parents */
+  gnode_t *end = gnode_get(graph->root, 'Z');
+  for (lnode_t *parent = end->parents; parent != NULL; parent = parent->next)
+    stream->size += parent->gnode->payload;
+  stream->results = mcalloc((stream->sink->mask + 2) * stream->size + 1);
+
+  graph->stream = stream;
+  streams_count++;
+}
+
+/*ANCHOR - stream: claim */
+/* A runner takes over a loop handed over by a producer, with the tasks queue
+   mutex locked. Returns NULL if another runner took it first.
+ */
+stream_t *stream_claim(void)
+{
+  for (int i = 0; i < graphs_count; i++)
+  {
+    stream_t *stream = graphs[i]->stream;
+    if (stream != NULL && atomic_exchange(&stream->handed, false))
+    {
+      atomic_fetch_sub(&streams_handed, 1);
+      return stream;
+    }
+  }
+  return NULL;
+}
+
+/*ANCHOR - stream: next loop */
+/* Start the loop of the next frame, if any; called by the owner of the
+   consumer side of the source ring, the runner at the end of a loop or the
+   producer that found the graph idle.
+ */
+void stream_next(stream_t *stream)
+{
+  while (!ring_pop(stream->source, &stream->frame))
+  {
+    /* a frame pushed after the pop and before the graph is marked idle
+       has not started a loop */
+    atomic_store(&stream->idle, true);
+    if (ring_empty(stream->source) || !atomic_exchange(&stream->idle, false))
+      return;
+  }
+  runner_loop_start(atomic_load(&stream->graph), stream->frame.time);
+}
+
+/*ANCHOR - stream: push */
+/* Producer side of the source. Returns false if the frame is dropped. */
+bool stream_push(stream_t *stream, frame_t frame)
+{
+  if (atomic_load(&stream->closed) || !ring_push(stream->source, frame))
+  {
+    stream->dropped++;
+    return false;
+  }
+  if (atomic_exchange(&stream->idle, false))
+  {
+    /* the producer owns the source consumer side: hand it over */
+    atomic_store(&stream->handed, true);
+    atomic_fetch_add(&streams_handed, 1);
+    cvar_signal(&tasks_queue_cvar);
+  }
+  return true;
+}
+
+/*ANCHOR - stream: result */
+/* Called by the runner of Z, before its inputs are released: the result
+   buffer of the next frame of the sink, if the sink has room for it */
+void stream_result(gnode_t *gnode)
+{
+  stream_t *stream = gnode->graph->stream;
+  size_t tail = atomic_load_explicit(&stream->sink->tail, memory_order_relaxed);
+  char *result = stream->results + tail % (stream->sink->mask + 2) * stream->size;
+
+  stream->room = !ring_full(stream->sink);
+  if (!stream->room)
+    return;
+
+  for (lnode_t *parent = gnode->parents; parent != NULL; parent = parent->next)
+    if (parent->edge->size > 0)
+    {
+      memcpy(result, edge_buffer(parent->edge, gnode->graph->loop), parent->edge->size);
+      result += parent->edge->size;
+    }
+}
+
+/*ANCHOR - stream: loop end */
+/* Called by the runner at the end of a loop */
+void stream_loop_end(graph_t *graph, bool last)
+{
+  stream_t *stream = graph->stream;
+  size_t tail = atomic_load_explicit(&stream->sink->tail, memory_order_relaxed);
+
+  stream->frame.data = stream->results + tail % (stream->sink->mask + 2) * stream->size;
+  if (!stream->room || !ring_push(stream->sink, stream->frame))
+    stream->lost++;
+  stream->room = false;
+  if (last)
+    atomic_store(&stream->closed, true);
+}
+
+/*ANCHOR - stream: pop */
+/* Consumer side of the sink. Returns false if there is no finished frame. */
+bool stream_pop(stream_t *stream, frame_t *frame)
+{
+  return ring_pop(stream->sink, frame);
+}
+
+/*ANCHOR - stream: closed */
+/* All the loops have run and all their frames have been popped */
+bool stream_closed(stream_t *stream)
+{
+  return atomic_load(&stream->closed) && ring_empty(stream->sink);
+}
+
+/*ANCHOR - stream: producer */
+/* Simulated capture thread: pushes a frame every period until the graph has
+   run all its loops.
+ */
+int impl_stream_producer(void *arg)
+{
+  stream_t *stream = (stream_t *)arg;
+  long next = now_ns();
+  long seq = 0;
+
+  while (!atomic_load(&stream->closed))
+  {
+    frame_t frame = {.seq = seq++, .time = now_ns(), .data = NULL};
+    if (stream_push(stream, frame))
+      stream->pushed++;
+
+    next += stream->period;
+    long now = now_ns();
+    if (next < now)
+      next = now;
+    struct timespec time = {.tv_sec = (next - now) / 1000000000L,
+                            .tv_nsec = (next - now) % 1000000000L};
+    thrd_sleep(&time, NULL);
+  }
+
+  return 0;
+}
+
+/*ANCHOR - stream: consumer */
+/* Simulated actuation thread: polls the sink until the graph is closed */
+int impl_stream_consumer(void *arg)
+{
+  stream_t *stream = (stream_t *)arg;
+  frame_t frame;
+
+  while (!stream_closed(stream))
+  {
+    if (!stream_pop(stream, &frame))
+    {
+      thrd_yield();
+      continue;
+    }
+    stream->latency += now_ns() - frame.time;
+    stream->popped++;
+  }
+
+  return 0;
+}
+
+/*ANCHOR - stream: start */
+void stream_start(graph_t *graph, int period)
+{
+  stream_t *stream = graph->stream;
+
+  stream->period = period * 1000L;
+  if (thrd_create(&stream->consumer, &impl_stream_consumer, stream) != thrd_success ||
+      thrd_create(&stream->producer, &impl_stream_producer, stream) != thrd_success)
+    exit(EXIT_FAILURE);
+}
+
+/*ANCHOR - stream: join */
+void stream_join(stream_t *stream)
+{
+  thrd_join(stream->producer, NULL);
+  thrd_join(stream->consumer, NULL);
+}
+
+/*ANCHOR - stream: print */
+void stream_print(graph_t *graph)
+{
+  stream_t *stream = graph->stream;
+
+  printf("%s: frames pushed %ld dropped %ld popped %ld lost %ld "
+         "mean latency %.3f ms\n",
+         graph->name, stream->pushed, stream->dropped, stream->popped,
+         stream->lost,
+         stream->popped > 0 ? stream->latency / 1e6 / stream->popped : 0.0);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Frame streams */
+#pragma endregion
+
+/* SECTION - Hot-swap */
+#pragma region
+/*****************************************************************************
+ *
+ *                     HOT-SWAP OF GRAPHS BETWEEN LOOPS
+ *
+ *****************************************************************************/
+
+/* A new compiled graph is published as the successor of a registered one.
+   Loops in flight finish on the old graph; at the end of the loop the runner
+   running 'Z' puts the successor in the registry and starts the next loop on
+   it, without stopping the runners or dropping frames. Like RCU, the old
+   graph is reclaimed after a grace period: once every runner has been in a
+   quiescent state (between two tasks), none of them can refer to it.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - rcu: retired graph */
+typedef struct retired
+{
+  graph_t *graph;
+  long *epochs;         /* epoch of each runner when the graph was retired */
+  struct retired *next;
+} retired_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - rcu: runners epoch */
+/* Incremented by each runner when it starts and ends a task: an even value
+   is a quiescent state. */
+atomic_long *rcu_epochs;
+
+/*ANCHOR - rcu: retired graphs */
+retired_t *rcu_retired = NULL;
+mtx_t rcu_retired_mtx;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - rcu: init */
+void rcu_init(int runners)
+{
+  rcu_epochs = mcalloc(sizeof(atomic_long) * runners);
+  for (int i = 0; i < runners; i++)
+    atomic_init(&rcu_epochs[i], 0);
+  mutex_init(&rcu_retired_mtx);
+}
+
+/*ANCHOR - rcu: enter */
+/* with the tasks queue mutex locked, so the graph of the task can't be
+   retired before the runner is seen as busy */
+void rcu_enter(int runner)
+{
+  atomic_fetch_add(&rcu_epochs[runner], 1);
+}
+
+/*ANCHOR - rcu: exit */
+void rcu_exit(int runner)
+{
+  atomic_fetch_add(&rcu_epochs[runner], 1);
+}
+
+/*ANCHOR - graph: free */
+void graph_free(graph_t *graph)
+{
+  for (int i = 0; i < graph->size; i++)
+  {
+    gnode_t *gnode = graph->nodes[i];
+    for (lnode_t *lnode = gnode->children, *next; lnode != NULL; lnode = next)
+    {
+      next = lnode->next;
+      if (graph->arena == NULL && !graph->payloads)
+        free(lnode->edge->buffer);
+      free(lnode->edge->released);
+      free(lnode->edge);
+      free(lnode);
+    }
+    for (lnode_t *lnode = gnode->parents, *next; lnode != NULL; lnode = next)
+    {
+      next = lnode->next;
+      free(lnode);
+    }
+    for (lnode_t *lnode = gnode->delays_out, *next; lnode != NULL; lnode = next)
+    {
+      next = lnode->next;
+      free(lnode->edge);
+      free(lnode);
+    }
+    for (lnode_t *lnode = gnode->delays_in, *next; lnode != NULL; lnode = next)
+    {
+      next = lnode->next;
+      free(lnode);
+    }
+    mtx_destroy(&gnode->mutex);
+    free(gnode);
+  }
+
+  if (graph->bitset != NULL)
+  {
+    for (int i = 0; i < graph->size; i++)
+      free(graph->bitset->parents[i]);
+    free(graph->bitset->parents);
+    free(graph->bitset->first);
+    free(graph->bitset->length);
+    free(graph->bitset->done);
+    free(graph->bitset->claimed);
+    free(graph->bitset);
+  }
+
+  if (graph->incremental)
+  {
+    mtx_destroy(&graph->dirty_mtx);
+    free(graph->dirty);
+    free(graph->affected);
+  }
+
+  mtx_destroy(&graph->exec_trace_mtx);
+  free(graph->arena);
+  free(graph->exec_trace);
+  free(graph->exec_time);
+  free(graph->order);
+  free(graph->level_count);
+  free(graph->mark);
+  free(graph->work);
+  free(graph->found);
+  free(graph->positions);
+  free(graph->nodes);
+  free(graph);
+}
+
+/*ANCHOR - rcu: reclaim */
+/* Free the retired graphs whose grace period has elapsed. Their statistics
+   are merged into the graph that replaced them in the registry, as late
+   runners may still update them after the swap.
+ */
+void rcu_reclaim(void)
+{
+  lock(&rcu_retired_mtx);
+  for (retired_t **retired = &rcu_retired; *retired != NULL;)
+  {
+    retired_t *entry = *retired;
+    bool quiescent = true;
+
+    for (int i = 0; i < runners_pool_size && quiescent; i++)
+      quiescent = entry->epochs[i] % 2 == 0 ||
+                  atomic_load(&rcu_epochs[i]) != entry->epochs[i];
+    if (!quiescent)
+    {
+      retired = &entry->next;
+      continue;
+    }
+
+    graph_t *graph = entry->graph;
+    lock(&tasks_queue_mtx);
+    {
+      graph_t *current = graphs[graph->id];
+      current->stolen += graph->stolen;
+      atomic_fetch_add(&current->release_ns, atomic_load(&graph->release_ns));
+      atomic_fetch_add(&current->release_edges, atomic_load(&graph->release_edges));
+    }
+    unlock(&tasks_queue_mtx);
+
+    *retired = entry->next;
+    graph_free(graph);
+    free(entry->epochs);
+    free(entry);
+  }
+  unlock(&rcu_retired_mtx);
+}
+
+/*ANCHOR - rcu: retire */
+void rcu_retire(graph_t *graph)
+{
+  retired_t *retired = mcalloc(sizeof(retired_t));
+
+  retired->graph = graph;
+  retired->epochs = mcalloc(sizeof(long) * runners_pool_size);
+  for (int i = 0; i < runners_pool_size; i++)
+    retired->epochs[i] = atomic_load(&rcu_epochs[i]);
+
+  lock(&rcu_retired_mtx);
+  retired->next = rcu_retired;
+  rcu_retired = retired;
+  unlock(&rcu_retired_mtx);
+}
+
+/*ANCHOR - graph: publish */
+/* Publish a new graph, already prepared, to replace the registered graph 'id'
+   from its next loop. A successor published before and not yet running is
+   discarded. An invalid graph (e.g. a mutation left a gnode without parents)
+   is freed instead, and false is returned.
+ */
+bool graph_publish(int id, graph_t *graph)
+{
+  graph_t *discarded;
+
+  if (!graph_validate(graph))
+  {
+    fprintf(stderr, "Error in graph %s: not published\n", graph->name);
+    graph_free(graph);
+    return false;
+  }
+
+  lock(&tasks_queue_mtx);
+  {
+    graph->id = id;
+    discarded = atomic_exchange(&graphs[id]->successor, graph);
+  }
+  unlock(&tasks_queue_mtx);
+
+  if (discarded != NULL)
+    graph_free(discarded);
+  return true;
+}
+
+/*ANCHOR - graph: swap */
+/* Called by the runner at the end of a loop of the graph, when no more tasks
+   of the graph are queued. Returns the graph to run the next loop.
+ */
+graph_t *graph_swap(graph_t *graph)
+{
+  graph_t *next;
+
+  if (atomic_load(&graph->successor) == NULL)
+    return graph;
+
+  lock(&tasks_queue_mtx);
+  {
+    next = atomic_exchange(&graph->successor, NULL);
+    next->priority = graph->priority;
+    next->weight = graph->weight;
+    next->deficit = graph->deficit;
+    graphs[graph->id] = next;
+  }
+  unlock(&tasks_queue_mtx);
+
+  next->loops = graph->loops;
+  next->loop = graph->loop;
+  next->exec_time = graph->exec_time;
+  graph->exec_time = NULL;
+  if (graph->incremental)
+  {
+    incremental_init(next);
+    next->affected_total = graph->affected_total;
+  }
+
+  if (graph->admission != NULL)
+  {
+    lock(&graph->admission->mutex);
+    graph->admission->graph = next;
+    unlock(&graph->admission->mutex);
+  }
+  next->admission = graph->admission;
+  graph->admission = NULL;
+  if (graph->stream != NULL)
+    atomic_store(&graph->stream->graph, next);
+  next->stream = graph->stream;
+  graph->stream = NULL;
+
+  printf("%s: hot-swap after loop %d to %d nodes\n", graph->name, graph->loop,
+         next->size);
+  rcu_retire(graph);
+  rcu_reclaim();
+
+  return next;
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Hot-swap */
+#pragma endregion
+
+/* SECTION - Multi-process executor */
+#pragma region
+/*****************************************************************************
+ *
+ *                         MULTI-PROCESS EXECUTOR
+ *
+ *****************************************************************************/
+
+/* In this mode runners are worker processes instead of threads, so that tasks
+   can be isolated from each other. The topology of the graph is inherited by
+   the workers with fork(): gnodes are at the same addresses in all processes
+   and are never modified. The runtime state of the graph (dependencies,
+   queue of tasks, loop counters, trace) and the edge buffers, or the arena
+   of the edge buffers, live in a POSIX shared memory segment; the state is
+   only accessed with process-shared atomics, futexes and a robust mutex.
+
+   The main process waits for the workers. If a worker dies while running a
+   task, the gnode is marked failed and the execution of the graph is stopped.
+   If it dies holding the mutex, the next process locking it gets the mutex
+   back from the kernel.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - workers: slot */
+typedef struct
+{
+  atomic_int pid;  /* worker process */
+  atomic_int node; /* gnode id of the task in flight, -1 if none */
+} worker_slot_t;
+
+/*ANCHOR - workers: shared state */
+/* Header of the shared memory segment; the arrays follow the header in the
+   same segment. */
+typedef struct
+{
+  pthread_mutex_t mutex;   /* robust lock: queue, loops and trace */
+  atomic_int queue_seq;    /* futex: incremented on each push and on stop */
+  atomic_int stop;         /* workers must exit */
+  int loop;                /* current loop number */
+  int loops;               /* total number of loops to run */
+  int failed;              /* gnode id of the failed task, -1 if none */
+  int head;                /* first gnode in the queue */
+  int length;              /* number of gnodes in the queue */
+  int *queue;              /* queue of tasks, circular buffer of gnode ids */
+  atomic_int *satisfied;   /* satisfied dependencies of each gnode */
+  exec_time_t *exec_time;  /* start and end of each loop */
+  char *exec_trace;        /* see #LINK - exec trace: global var */
+  worker_slot_t *workers;  /* one slot per worker */
+  char *buffers;           /* edge buffers, or the arena of the graph */
+} shared_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - workers: shared state */
+shared_t *shared;
+
+/*ANCHOR - workers: crash label */
+/* Kill the worker running the task with this label (0: none), to test the
+   detection of crashed workers */
+char workers_crash_label = 0;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - workers: shared buffers */
+/* Bytes of the edge buffers in the shared segment: the arena of the graph if
+   it is planned, or a buffer per edge, aligned to a cache line */
+size_t impl_shared_buffers_size(graph_t *graph)
+{
+  size_t size = 0;
+
+  if (graph->arena != NULL)
+    return graph->arena_size;
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+      size += (child->edge->size + 63) & ~(size_t)63;
+  return size;
+}
+
+/*ANCHOR - workers: move buffers */
+/* Move the edge buffers to the shared segment, before the workers fork */
+void impl_shared_buffers_move(graph_t *graph)
+{
+  size_t offset = 0;
+
+  if (graph->arena != NULL)
+  {
+    for (int i = 0; i < graph->size; i++)
+      for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+        if (child->edge->size > 0)
+          child->edge->buffer = shared->buffers + (child->edge->buffer - graph->arena);
+    free(graph->arena);
+    graph->arena = NULL;
+    return;
+  }
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+      if (child->edge->size > 0)
+      {
+        free(child->edge->buffer);
+        child->edge->buffer = shared->buffers + offset;
+        offset += (child->edge->size + 63) & ~(size_t)63;
+      }
+}
+
+/*ANCHOR - workers: shared init */
+void shared_init(graph_t *graph, int workers, int loops)
+{
+  char name[64];
+  pthread_mutexattr_t attr;
+  size_t header = sizeof(shared_t) + sizeof(int) * graph->size +
+                  sizeof(atomic_int) * graph->size + sizeof(exec_time_t) * loops +
+                  sizeof(worker_slot_t) * workers + 2 * graph->size + 1;
+  size_t offset = (header + 63) & ~(size_t)63;
+  size_t size = offset + impl_shared_buffers_size(graph);
+
+  snprintf(name, sizeof(name), "/graph-c-%d", getpid());
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1 || ftruncate(fd, size) == -1)
+  {
+    fprintf(stderr, "Error in shm_open\n");
+    exit(EXIT_FAILURE);
+  }
+  shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (shared == MAP_FAILED)
+  {
+    fprintf(stderr, "Error in mmap\n");
+    exit(EXIT_FAILURE);
+  }
+  /* the mapping is kept by the workers after fork() */
+  close(fd);
+  shm_unlink(name);
+
+  /* the segment is mapped at the same address in all processes */
+  memset(shared, 0, size);
+  shared->workers = (worker_slot_t *)(shared + 1);
+  shared->exec_time = (exec_time_t *)(shared->workers + workers);
+  shared->satisfied = (atomic_int *)(shared->exec_time + loops);
+  shared->queue = (int *)(shared->satisfied + graph->size);
+  shared->exec_trace = (char *)(shared->queue + graph->size);
+  shared->buffers = (char *)shared + offset;
+  impl_shared_buffers_move(graph);
+
+  if (pthread_mutexattr_init(&attr) != 0 ||
+      pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 ||
+      pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) != 0 ||
+      pthread_mutex_init(&shared->mutex, &attr) != 0)
+  {
+    fprintf(stderr, "Error in pthread_mutex_init\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_mutexattr_destroy(&attr);
+  atomic_init(&shared->queue_seq, 0);
+  atomic_init(&shared->stop, 0);
+  shared->loops = loops;
+  shared->failed = -1;
+  for (int i = 0; i < graph->size; i++)
+    atomic_init(&shared->satisfied[i], 0);
+  for (int i = 0; i < workers; i++)
+  {
+    atomic_init(&shared->workers[i].pid, 0);
+    atomic_init(&shared->workers[i].node, -1);
+  }
+}
+
+/*ANCHOR - workers: lock */
+/* If the owner died holding the mutex, the kernel hands it over to the next
+   process locking it. The state it protects may be half updated, but the
+   main process stops the execution once it sees the dead worker. */
+void shared_lock(void)
+{
+  int result = pthread_mutex_lock(&shared->mutex);
+
+  if (result == EOWNERDEAD)
+    result = pthread_mutex_consistent(&shared->mutex);
+  if (result != 0)
+  {
+    fprintf(stderr, "Error in pthread_mutex_lock\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*ANCHOR - workers: unlock */
+void shared_unlock(void)
+{
+  if (pthread_mutex_unlock(&shared->mutex) != 0)
+  {
+    fprintf(stderr, "Error in pthread_mutex_unlock\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*ANCHOR - workers: push back */
+/* with the shared mutex locked */
+void shared_push_back(graph_t *graph, gnode_t *gnode)
+{
+  shared->queue[(shared->head + shared->length) % graph->size] = gnode->id;
+  shared->length++;
+  atomic_fetch_add(&shared->queue_seq, 1);
+  futex_wake(&shared->queue_seq, 1);
+}
+
+/*ANCHOR - workers: stop */
+/* with the shared mutex locked */
+void shared_stop(void)
+{
+  atomic_store(&shared->stop, 1);
+  atomic_fetch_add(&shared->queue_seq, 1);
+  futex_wake(&shared->queue_seq, INT_MAX);
+}
+
+/*ANCHOR - workers: loop start */
+/* with the shared mutex locked */
+void shared_loop_start(graph_t *graph)
+{
+  shared->loop++;
+  LOG_LOOPS ? printf("-- %s start of loop %d\n", graph->name, shared->loop) : 0;
+  shared->exec_time[shared->loop - 1].start = now_ns();
+  shared->exec_trace[0] = 0;
+  shared_push_back(graph, graph->root);
+}
+
+/*ANCHOR - workers: trace append */
+void shared_trace_append(char label)
+{
+  shared_lock();
+  {
+    int i = strlen(shared->exec_trace);
+    shared->exec_trace[i] = label;
+    shared->exec_trace[i + 1] = 0;
+  }
+  shared_unlock();
+}
+
+/*ANCHOR - workers: implementation */
+/* Same algorithm as #LINK - runner: implementation, on the shared state */
+void worker(graph_t *graph, int id)
+{
+  gnode_t *gnode;
+  context_t context;
+
+  LOG_RUNNER_LIFECYCLE ? printf("worker %d start, pid %d\n", id, getpid()) : 0;
+  context_init(&context, id);
+
+  for (;;)
+  {
+    /* wait for new pending tasks */
+    shared_lock();
+    while (shared->length == 0 && !atomic_load(&shared->stop))
+    {
+      int seq = atomic_load(&shared->queue_seq);
+      shared_unlock();
+      futex_wait(&shared->queue_seq, seq);
+      shared_lock();
+    }
+
+    if (atomic_load(&shared->stop))
+    {
+      shared_unlock();
+      break;
+    }
+
+    /* get first pending task */
+    gnode = graph->nodes[shared->queue[shared->head]];
+    shared->head = (shared->head + 1) % graph->size;
+    shared->length--;
+    atomic_store(&shared->workers[id].node, gnode->id);
+    shared_unlock();
+
+    /* execute task */
+    LOG_RUNNER_TASK ? printf("worker %d task %c\n", id, gnode->label) : 0;
+    shared_trace_append(gnode->label);
+    if (gnode->label == workers_crash_label)
+      kill(getpid(), SIGKILL);
+    task_run(gnode, &context, shared->loop);
+    gnode_output(gnode, shared->loop);
+    shared_trace_append(gnode->label);
+
+    /* reset satisfied dependencies for next loop */
+    atomic_store(&shared->satisfied[gnode->id], 0);
+
+    if (gnode->label == 'Z')
+    {
+      shared_lock();
+      {
+        shared->exec_time[shared->loop - 1].end = now_ns();
+        LOG_LOOPS ? printf("-- %s end of loop %d\n", graph->name, shared->loop) : 0;
+        LOG_EXEC_TRACE ? printf("%s exec trace: %s\n", graph->name, shared->exec_trace) : 0;
+        if (shared->loop == shared->loops)
+          shared_stop();
+        else
+          shared_loop_start(graph);
+      }
+      shared_unlock();
+    }
+    else
+    {
+      /* update children dependencies; if met, append child to task queue */
+      lnode_t *child = gnode->children;
+      while (child != NULL)
+      {
+        if (atomic_fetch_add(&shared->satisfied[child->gnode->id], 1) + 1 ==
+            child->gnode->deps.required)
+        {
+          shared_lock();
+          shared_push_back(graph, child->gnode);
+          shared_unlock();
+        }
+        child = child->next;
+      }
+    }
+    atomic_store(&shared->workers[id].node, -1);
+  }
+
+  context_free(&context);
+  LOG_RUNNER_LIFECYCLE ? printf("worker %d exit\n", id) : 0;
+}
+
+/*ANCHOR - workers: run */
+/* Run the graph the specified number of loops with a pool of worker
+   processes. Returns false if a worker crashed.
+ */
+bool workers_run(graph_t *graph, int workers, int loops)
+{
+  int alive = workers;
+
+  graph->loops = loops;
+  exec_time_init(graph);
+  shared_init(graph, workers, loops);
+
+  shared_lock();
+  shared_loop_start(graph);
+  shared_unlock();
+
+  fflush(stdout);
+  for (int i = 0; i < workers; i++)
+  {
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+      fprintf(stderr, "Error in fork\n");
+      exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+      worker(graph, i);
+      fflush(stdout);
+      _exit(EXIT_SUCCESS);
+    }
+    atomic_store(&shared->workers[i].pid, pid);
+  }
+
+  /* detect crashed workers */
+  while (alive > 0)
+  {
+    int status, id = -1;
+    pid_t pid = wait(&status);
+    if (pid == -1)
+      break;
+    alive--;
+
+    for (int i = 0; i < workers; i++)
+      if (atomic_load(&shared->workers[i].pid) == pid)
+        id = i;
+    if (id == -1 || (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS))
+      continue;
+
+    int node = atomic_load(&shared->workers[id].node);
+    fprintf(stderr, "worker %d (pid %d) crashed", id, pid);
+    if (node != -1)
+      fprintf(stderr, " running task %c, marked failed", graph->nodes[node]->label);
+    fprintf(stderr, "\n");
+
+    shared_lock();
+    {
+      if (shared->failed == -1)
+        shared->failed = node;
+      shared_stop();
+    }
+    shared_unlock();
+  }
+
+  /* completed loops */
+  graph->loop = shared->loop - (shared->failed != -1 || !atomic_load(&shared->stop));
+  memcpy(graph->exec_time, shared->exec_time, sizeof(exec_time_t) * loops);
+  printf("%s: %d loops, %d workers\n", graph->name, graph->loop, workers);
+
+  return shared->failed == -1;
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Multi-process executor */
+#pragma endregion
+
+/* SECTION - Graph partitioning */
+#pragma region
+/*****************************************************************************
+ *
+ *                           GRAPH PARTITIONING
+ *
+ *****************************************************************************/
+
+/* The gnodes of a graph are split in groups (e.g. one group per cluster node).
+   Edges between gnodes of different groups are cut: their payload must be
+   sent from one group to the other in each loop.
+ */
+
+/* SECTION - Functions */
+
+/*ANCHOR - partition: cut */
+/* Bytes sent between groups in each loop */
+long partition_cut(graph_t *graph)
+{
+  long cut = 0;
+
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+      if (child->gnode->group != graph->nodes[i]->group)
+        cut += child->edge->size;
+
+  return cut;
+}
+
+/*ANCHOR - partition: pgraph */
+/* Undirected graph used by the partitioner, in compressed sparse rows. The
+   vertices of a coarse pgraph are sets of vertices of the finer one, with
+   the gnodes of each topological level in a vertex as a sparse list sorted
+   by level. Merged vertices never share a level, so the lists of a pgraph
+   hold one entry per gnode at most.
+ */
+typedef struct pgraph
+{
+  int n;              /* number of vertices */
+  int *xadj;          /* neighbors of v: adjncy[xadj[v] .. xadj[v + 1] - 1] */
+  int *adjncy;
+  long *adjwgt;       /* edge weight: bytes of the payload, plus one */
+  int *vwgt;          /* vertex weight: number of gnodes */
+  int *lxadj;         /* levels of v: level[lxadj[v] .. lxadj[v + 1] - 1] */
+  int *level;
+  int *lcount;        /* gnodes of v in each of its levels */
+  int *cmap;          /* vertex of the coarser pgraph */
+  int *part;          /* group of each vertex */
+  struct pgraph *coarser;
+} pgraph_t;
+
+/*ANCHOR - partition: vertex key */
+/* Vertices sorted by a key, e.g. the gain of a move */
+typedef struct
+{
+  long key;
+  int u;
+} pgraph_key_t;
+
+/*ANCHOR - partition: pgraph constructor */
+/* Allocate a pgraph of n vertices with room for 'edges' directed edges and
+   'entries' levels of the vertices */
+pgraph_t *impl_pgraph_new(int n, int edges, int entries)
+{
+  pgraph_t *pgraph = mcalloc(sizeof(pgraph_t));
+
+  pgraph->n = n;
+  pgraph->xadj = mcalloc(sizeof(int) * (n + 1));
+  pgraph->adjncy = mcalloc(sizeof(int) * (edges + 1));
+  pgraph->adjwgt = mcalloc(sizeof(long) * (edges + 1));
+  pgraph->vwgt = mcalloc(sizeof(int) * n);
+  pgraph->lxadj = mcalloc(sizeof(int) * (n + 1));
+  pgraph->level = mcalloc(sizeof(int) * (entries + 1));
+  pgraph->lcount = mcalloc(sizeof(int) * (entries + 1));
+  pgraph->cmap = mcalloc(sizeof(int) * n);
+  pgraph->part = mcalloc(sizeof(int) * n);
+
+  return pgraph;
+}
+
+/*ANCHOR - partition: pgraph merge */
+/* Merge the parallel edges of each vertex, adding their weights, with an
+   accumulator indexed by neighbor: O(V + E). Weights are positive. */
+void impl_pgraph_merge(pgraph_t *pgraph)
+{
+  long *weight = mcalloc(sizeof(long) * pgraph->n);
+  int edges = 0;
+
+  for (int u = 0; u < pgraph->n; u++)
+  {
+    int first = edges;
+
+    /* edges are compacted in place, never beyond the one being read */
+    for (int e = pgraph->xadj[u]; e < pgraph->xadj[u + 1]; e++)
+    {
+      int v = pgraph->adjncy[e];
+      if (weight[v] == 0)
+        pgraph->adjncy[edges++] = v;
+      weight[v] += pgraph->adjwgt[e];
+    }
+    for (int e = first; e < edges; e++)
+    {
+      pgraph->adjwgt[e] = weight[pgraph->adjncy[e]];
+      weight[pgraph->adjncy[e]] = 0;
+    }
+    pgraph->xadj[u] = first;
+  }
+  pgraph->xadj[pgraph->n] = edges;
+
+  free(weight);
+}
+
+/*ANCHOR - partition: pgraph destructor */
+void impl_pgraph_free(pgraph_t *pgraph)
+{
+  free(pgraph->xadj);
+  free(pgraph->adjncy);
+  free(pgraph->adjwgt);
+  free(pgraph->vwgt);
+  free(pgraph->lxadj);
+  free(pgraph->level);
+  free(pgraph->lcount);
+  free(pgraph->cmap);
+  free(pgraph->part);
+  free(pgraph);
+}
+
+/*ANCHOR - partition: same levels */
+/* Vertices with the same gnodes per level */
+bool impl_pgraph_same_levels(pgraph_t *pgraph, int u, int v)
+{
+  int length = pgraph->lxadj[u + 1] - pgraph->lxadj[u];
+
+  return length == pgraph->lxadj[v + 1] - pgraph->lxadj[v] &&
+         memcmp(pgraph->level + pgraph->lxadj[u], pgraph->level + pgraph->lxadj[v],
+                sizeof(int) * length) == 0 &&
+         memcmp(pgraph->lcount + pgraph->lxadj[u], pgraph->lcount + pgraph->lxadj[v],
+                sizeof(int) * length) == 0;
+}
+
+/*ANCHOR - partition: coarsen */
+/* Heavy-edge matching: each vertex is merged with the unmatched neighbor
+   connected by the heaviest edge. Vertices with gnodes of the same level are
+   never merged, so that the tasks of a stage can still be spread among all
+   groups; 'mark' tells the levels of the vertex being matched. Returns NULL
+   if the pgraph cannot be reduced.
+ */
+pgraph_t *impl_pgraph_coarsen(pgraph_t *fine, int levels)
+{
+  int *mark = mcalloc(sizeof(int) * levels);
+  int n = 0;
+
+  for (int u = 0; u < fine->n; u++)
+    fine->cmap[u] = -1;
+
+  for (int u = 0; u < fine->n; u++)
+  {
+    int best = -1;
+
+    if (fine->cmap[u] != -1)
+      continue;
+    for (int i = fine->lxadj[u]; i < fine->lxadj[u + 1]; i++)
+      mark[fine->level[i]] = u + 1;
+    for (int e = fine->xadj[u]; e < fine->xadj[u + 1]; e++)
+    {
+      int v = fine->adjncy[e];
+      bool disjoint = fine->cmap[v] == -1;
+
+      for (int i = fine->lxadj[v]; i < fine->lxadj[v + 1] && disjoint; i++)
+        disjoint = mark[fine->level[i]] != u + 1;
+      if (disjoint && (best == -1 || fine->adjwgt[e] > fine->adjwgt[best]))
+        best = e;
+    }
+    fine->cmap[u] = n;
+    if (best != -1)
+      fine->cmap[fine->adjncy[best]] = n;
+    n++;
+  }
+  free(mark);
+
+  if (n > 0.9 * fine->n)
+    return NULL;
+
+  /* fine vertices of each coarse vertex, by counting sort */
+  int *first = mcalloc(sizeof(int) * (n + 1));
+  int *members = mcalloc(sizeof(int) * fine->n);
+  for (int u = 0; u < fine->n; u++)
+    first[fine->cmap[u] + 1]++;
+  for (int c = 0; c < n; c++)
+    first[c + 1] += first[c];
+  for (int u = 0; u < fine->n; u++)
+    members[first[fine->cmap[u]]++] = u;
+  for (int c = n; c > 0; c--)
+    first[c] = first[c - 1];
+  first[0] = 0;
+
+  /* edges of the members to other coarse vertices, then merged; the levels
+     of the one or two members, merged in level order */
+  pgraph_t *coarse = impl_pgraph_new(n, fine->xadj[fine->n], fine->lxadj[fine->n]);
+  int edges = 0, entries = 0;
+  for (int c = 0; c < n; c++)
+  {
+    int u = members[first[c]];
+    int v = first[c + 1] - first[c] > 1 ? members[first[c] + 1] : u;
+    int i = fine->lxadj[u], j = v != u ? fine->lxadj[v] : fine->lxadj[v + 1];
+
+    coarse->lxadj[c] = entries;
+    while (i < fine->lxadj[u + 1] || j < fine->lxadj[v + 1])
+    {
+      int k = j == fine->lxadj[v + 1] ||
+                      (i < fine->lxadj[u + 1] && fine->level[i] < fine->level[j])
+                  ? i++
+                  : j++;
+      coarse->level[entries] = fine->level[k];
+      coarse->lcount[entries++] = fine->lcount[k];
+    }
+
+    coarse->xadj[c] = edges;
+    for (int m = first[c]; m < first[c + 1]; m++)
+    {
+      u = members[m];
+      coarse->vwgt[c] += fine->vwgt[u];
+      for (int e = fine->xadj[u]; e < fine->xadj[u + 1]; e++)
+        if (fine->cmap[fine->adjncy[e]] != c)
+        {
+          coarse->adjncy[edges] = fine->cmap[fine->adjncy[e]];
+          coarse->adjwgt[edges++] = fine->adjwgt[e];
+        }
+    }
+  }
+  coarse->xadj[n] = edges;
+  coarse->lxadj[n] = entries;
+  impl_pgraph_merge(coarse);
+
+  free(first);
+  free(members);
+  return coarse;
+}
+
+/*ANCHOR - partition: fits */
+/* A vertex fits in a group if no level exceeds its capacity in the group */
+bool impl_pgraph_fits(pgraph_t *pgraph, int u, int *count, int *capacity)
+{
+  for (int i = pgraph->lxadj[u]; i < pgraph->lxadj[u + 1]; i++)
+    if (count[pgraph->level[i]] + pgraph->lcount[i] > capacity[pgraph->level[i]])
+      return false;
+  return true;
+}
+
+/*ANCHOR - partition: move */
+/* Move a vertex to a group; the connection of its neighbors to the groups
+   is updated if 'conn' is not NULL */
+void impl_pgraph_move(pgraph_t *pgraph, int u, int group, int *count, int levels,
+                      long *conn, int groups)
+{
+  for (int i = pgraph->lxadj[u]; i < pgraph->lxadj[u + 1]; i++)
+  {
+    count[pgraph->part[u] * levels + pgraph->level[i]] -= pgraph->lcount[i];
+    count[group * levels + pgraph->level[i]] += pgraph->lcount[i];
+  }
+  if (conn != NULL)
+    for (int e = pgraph->xadj[u]; e < pgraph->xadj[u + 1]; e++)
+    {
+      conn[pgraph->adjncy[e] * groups + pgraph->part[u]] -= pgraph->adjwgt[e];
+      conn[pgraph->adjncy[e] * groups + group] += pgraph->adjwgt[e];
+    }
+  pgraph->part[u] = group;
+}
+
+/*ANCHOR - partition: initial */
+/* Greedy partition of the coarsest pgraph: heavier vertices first, each one
+   to the group it is most connected to among those where it fits. */
+void impl_pgraph_initial(pgraph_t *pgraph, int groups, int *count, int *capacity,
+                         int levels)
+{
+  long *conn = mcalloc(sizeof(long) * groups);
+  bool *done = mcalloc(sizeof(bool) * pgraph->n);
+
+  for (int k = 0; k < pgraph->n; k++)
+  {
+    int u = -1, best = -1;
+
+    for (int v = 0; v < pgraph->n; v++)
+      if (!done[v] && (u == -1 || pgraph->vwgt[v] > pgraph->vwgt[u]))
+        u = v;
+    done[u] = true;
+
+    memset(conn, 0, sizeof(long) * groups);
+    for (int e = pgraph->xadj[u]; e < pgraph->xadj[u + 1]; e++)
+      if (done[pgraph->adjncy[e]])
+        conn[pgraph->part[pgraph->adjncy[e]]] += pgraph->adjwgt[e];
+
+    for (int g = 0; g < groups; g++)
+    {
+      int load = 0, best_load = 0;
+      for (int l = 0; l < levels; l++)
+      {
+        load += count[g * levels + l];
+        best_load += best == -1 ? 0 : count[best * levels + l];
+      }
+      bool fits = impl_pgraph_fits(pgraph, u, count + g * levels, capacity);
+      bool best_fits = best != -1 &&
+                       impl_pgraph_fits(pgraph, u, count + best * levels, capacity);
+      if (best == -1 || (fits && !best_fits) ||
+          (fits == best_fits &&
+           (conn[g] > conn[best] || (conn[g] == conn[best] && load < best_load))))
+        best = g;
+    }
+
+    pgraph->part[u] = best;
+    for (int i = pgraph->lxadj[u]; i < pgraph->lxadj[u + 1]; i++)
+      count[best * levels + pgraph->level[i]] += pgraph->lcount[i];
+  }
+
+  free(conn);
+  free(done);
+}
+
+/*ANCHOR - partition: compare keys */
+/* Larger keys first, then by vertex */
+int impl_pgraph_compare(const void *a, const void *b)
+{
+  const pgraph_key_t *x = (const pgraph_key_t *)a;
+  const pgraph_key_t *y = (const pgraph_key_t *)b;
+
+  if (x->key != y->key)
+    return x->key < y->key ? 1 : -1;
+  return x->u - y->u;
+}
+
+/*ANCHOR - partition: refine */
+/* Boundary refinement: in each pass, the vertices connected to another group
+   are visited by decreasing gain, and each one is moved to the group that
+   reduces the weight of the cut edges the most, if it respects the capacity
+   of the groups; the gains are kept up to date after each move. Vertices that
+   can't move are swapped with boundary vertices of another group with the
+   same gnodes per level, found among those with the same hash of their
+   levels, when the swap reduces the cut. Each move or swap reduces the cut,
+   so the passes stop once one of them makes no improvement.
+ */
+void impl_pgraph_refine(pgraph_t *pgraph, int groups, int *count, int *capacity,
+                        int levels)
+{
+  long *conn = mcalloc(sizeof(long) * pgraph->n * groups);
+  pgraph_key_t *boundary = mcalloc(sizeof(pgraph_key_t) * (pgraph->n + 1));
+  bool improved = true;
+
+  /* connection of each vertex to each group */
+  for (int u = 0; u < pgraph->n; u++)
+    for (int e = pgraph->xadj[u]; e < pgraph->xadj[u + 1]; e++)
+      conn[u * groups + pgraph->part[pgraph->adjncy[e]]] += pgraph->adjwgt[e];
+
+  while (improved)
+  {
+    int length = 0, stuck = 0;
+    improved = false;
+
+    /* boundary vertices by decreasing gain of their best move */
+    for (int u = 0; u < pgraph->n; u++)
+    {
+      long *c = conn + u * groups, gain = LONG_MIN;
+      for (int g = 0; g < groups; g++)
+        if (g != pgraph->part[u] && c[g] > 0 && c[g] - c[pgraph->part[u]] > gain)
+          gain = c[g] - c[pgraph->part[u]];
+      if (gain != LONG_MIN)
+        boundary[length++] = (pgraph_key_t){.key = gain, .u = u};
+    }
+    qsort(boundary, length, sizeof(pgraph_key_t), impl_pgraph_compare);
+
+    /* moves */
+    for (int k = 0; k < length; k++)
+    {
+      int u = boundary[k].u, from = pgraph->part[u], best = -1;
+      long *c = conn + u * groups;
+
+      for (int g = 0; g < groups; g++)
+        if (g != from && c[g] > c[from] && (best == -1 || c[g] > c[best]) &&
+            impl_pgraph_fits(pgraph, u, count + g * levels, capacity))
+          best = g;
+      if (best != -1)
+      {
+        impl_pgraph_move(pgraph, u, best, count, levels, conn, groups);
+        improved = true;
+      }
+      else
+        boundary[stuck++].u = u;
+    }
+
+    /* swaps of the vertices that can't move, by hash of their levels */
+    for (int k = 0; k < stuck; k++)
+    {
+      uint64_t hash = 14695981039346656037UL;
+      int u = boundary[k].u;
+      for (int i = pgraph->lxadj[u]; i < pgraph->lxadj[u + 1]; i++)
+        hash = ((hash ^ (uint64_t)pgraph->level[i]) * 1099511628211UL ^
+                (uint64_t)pgraph->lcount[i]) * 1099511628211UL;
+      boundary[k].key = (long)(hash >> 1);
+    }
+    qsort(boundary, stuck, sizeof(pgraph_key_t), impl_pgraph_compare);
+
+    for (int first = 0, last = 0; first < stuck; first = last)
+    {
+      while (last < stuck && boundary[last].key == boundary[first].key)
+        last++;
+      for (int i = first; i < last; i++)
+        for (int j = i + 1; j < last; j++)
+        {
+          int u = boundary[i].u, v = boundary[j].u;
+          int from = pgraph->part[u], to = pgraph->part[v];
+          long between = 0;
+
+          if (from == to)
+            continue;
+          long gain = conn[u * groups + to] - conn[u * groups + from] +
+                      conn[v * groups + from] - conn[v * groups + to];
+          if (gain <= 0 || !impl_pgraph_same_levels(pgraph, u, v))
+            continue;
+          for (int e = pgraph->xadj[u]; e < pgraph->xadj[u + 1]; e++)
+            if (pgraph->adjncy[e] == v)
+              between = pgraph->adjwgt[e];
+          if (gain - 2 * between > 0)
+          {
+            impl_pgraph_move(pgraph, u, to, count, levels, conn, groups);
+            impl_pgraph_move(pgraph, v, from, count, levels, conn, groups);
+            improved = true;
+          }
+        }
+    }
+  }
+
+  free(conn);
+  free(boundary);
+}
+
+/*ANCHOR - partition: multilevel */
+/* Multilevel partitioning, in the spirit of METIS:
+     - coarsen: merge heavily connected vertices until the graph is small
+     - initial partition of the coarsest graph
+     - uncoarsen: project the partition to the finer graphs, refining the cut
+       at each step
+   Edges are weighted by their payload. Groups are balanced per topological
+   level: a group holds at most ceil(n / groups) of the n gnodes of a level,
+   so that the parallelism of each stage is preserved. The result is the
+   group of each gnode, used as an affinity hint by the executors.
+ */
+void partition_multilevel(graph_t *graph, int groups)
+{
+  int levels = graph->levels;
+  int n = graph->size;
+  int edges = 0;
+  int *capacity = mcalloc(sizeof(int) * levels);
+  int *count = mcalloc(sizeof(int) * groups * levels);
+
+  for (int i = 0; i < n; i++)
+  {
+    capacity[graph->nodes[i]->level]++;
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+      edges += 2;
+  }
+  for (int l = 0; l < levels; l++)
+    capacity[l] = (capacity[l] + groups - 1) / groups;
+
+  /* undirected: the children and the parents of each gnode */
+  pgraph_t *finest = impl_pgraph_new(n, edges, n);
+  edges = 0;
+  for (int i = 0; i < n; i++)
+  {
+    gnode_t *gnode = graph->nodes[i];
+    finest->xadj[i] = edges;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    {
+      finest->adjncy[edges] = child->gnode->id;
+      finest->adjwgt[edges++] = child->edge->size + 1;
+    }
+    for (lnode_t *parent = gnode->parents; parent != NULL; parent = parent->next)
+    {
+      finest->adjncy[edges] = parent->gnode->id;
+      finest->adjwgt[edges++] = parent->edge->size + 1;
+    }
+    finest->vwgt[i] = 1;
+    finest->lxadj[i] = i;
+    finest->level[i] = gnode->level;
+    finest->lcount[i] = 1;
+  }
+  finest->xadj[n] = edges;
+  finest->lxadj[n] = n;
+  impl_pgraph_merge(finest);
+
+  /* coarsen */
+  pgraph_t *pgraph = finest;
+  while (pgraph->n > 2 * groups && (pgraph->coarser = impl_pgraph_coarsen(pgraph, levels)) != NULL)
+    pgraph = pgraph->coarser;
+
+  /* initial partition */
+  impl_pgraph_initial(pgraph, groups, count, capacity, levels);
+  impl_pgraph_refine(pgraph, groups, count, capacity, levels);
+
+  /* uncoarsen */
+  while (pgraph != finest)
+  {
+    pgraph_t *fine = finest;
+    while (fine->coarser != pgraph)
+      fine = fine->coarser;
+    for (int u = 0; u < fine->n; u++)
+      fine->part[u] = pgraph->part[fine->cmap[u]];
+    impl_pgraph_free(pgraph);
+    fine->coarser = NULL;
+    pgraph = fine;
+    impl_pgraph_refine(pgraph, groups, count, capacity, levels);
+  }
+
+  for (int i = 0; i < n; i++)
+    graph->nodes[i]->group = finest->part[i];
+
+  impl_pgraph_free(finest);
+  free(capacity);
+  free(count);
+}
+
+/*ANCHOR - partition: print */
+void partition_print(graph_t *graph, int groups)
+{
+  for (int g = 0; g < groups; g++)
+  {
+    printf("%s: group %d:", graph->name, g);
+    for (int i = 0; i < graph->size; i++)
+      if (graph->nodes[i]->group == g)
+        printf(" %c", graph->nodes[i]->label);
+    printf("\n");
+  }
+  printf("%s: %ld bytes per loop between groups\n", graph->name, partition_cut(graph));
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Graph partitioning */
+#pragma endregion
+
+/* SECTION - Distributed executor */
+#pragma region
+/*****************************************************************************
+ *
+ *                          DISTRIBUTED EXECUTOR
+ *
+ *****************************************************************************/
+
+/* The graph is partitioned among several executor processes, the cluster
+   nodes, connected with stream sockets. Each cluster node runs the tasks of
+   its group with its own pool of runner threads. When a task finishes, the
+   children in the same group are released locally; for the children in
+   other groups, a release record and the edge payload are added to the batch
+   of the cluster node owning the child. Batches are sent by a runner that
+   finds no more local work, with a single sendmsg() per destination:
+   payloads are gathered directly from the edge buffers and scattered
+   directly into the edge buffers of the receiver, without intermediate
+   copies.
+
+   Sends block when the socket buffer is full, so each cluster node has a
+   receiver thread that only reads the sockets and never sends: the peers
+   always drain each other and two cluster nodes sending large batches to
+   each other can't deadlock. For the same reason a runner never holds the
+   mutex of the cluster node, which the receiver needs, while it waits for
+   the lock of a batch, which a blocked sender holds.
+
+   The cluster node owning 'Z' counts the loops: it starts a new loop (in the
+   cluster node owning the root) or stops all cluster nodes.
+
+   Here cluster nodes are forked processes connected with Unix socket pairs,
+   or with TCP connections over the loopback interface; both are test
+   harnesses for the protocol, which only needs a connected stream socket
+   between each pair of cluster nodes.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - cluster: message type */
+typedef enum
+{
+  MSG_RELEASE, /* release records followed by edge payloads */
+  MSG_LOOP,    /* start a new loop */
+  MSG_STOP     /* all loops completed */
+} msg_type_t;
+
+/*ANCHOR - cluster: message header */
+typedef struct
+{
+  int type;
+  int loop;
+  int count; /* number of release records */
+} msg_header_t;
+
+/*ANCHOR - cluster: release record */
+/* Edge parent --> child, by gnode id */
+typedef struct
+{
+  int parent;
+  int child;
+} msg_record_t;
+
+/*ANCHOR - cluster: batch */
+/* Pending release records and payloads for a cluster node. The mutex also
+   serialises the messages sent to the cluster node. */
+typedef struct
+{
+  msg_header_t header;
+  msg_record_t *records;
+  struct iovec *iov;  /* header, records and payloads */
+  mtx_t mutex;
+} batch_t;
+
+/*ANCHOR - cluster: state */
+/* State of the executor in a cluster node; the mutex protects the queue,
+   the dependencies, the loop and the stop flag */
+typedef struct
+{
+  int id;             /* this cluster node, the group it runs */
+  int size;           /* number of cluster nodes */
+  int runners;        /* runner threads of the cluster node */
+  int *fds;           /* socket connected to each cluster node */
+  int wake[2];        /* pipe to stop the receiver */
+  batch_t *batches;   /* batch for each cluster node */
+  int *satisfied;     /* satisfied dependencies of each gnode */
+  int *queue;         /* queue of tasks, circular buffer of gnode ids */
+  int head;
+  int length;
+  int loop;           /* current loop */
+  bool stop;
+  graph_t *graph;
+  mtx_t mutex;
+  cnd_t cvar;
+} cluster_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - cluster: state */
+cluster_t cluster;
+
+/*ANCHOR - cluster: tcp */
+/* Connect the cluster nodes with TCP over the loopback interface */
+bool cluster_tcp = false;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - cluster: init */
+void cluster_init(graph_t *graph, int id, int size, int runners, int *fds)
+{
+  int edges = 0;
+
+  for (int i = 0; i < graph->size; i++)
+    edges += graph->nodes[i]->deps.required;
+
+  cluster.id = id;
+  cluster.size = size;
+  cluster.runners = runners;
+  cluster.fds = fds;
+  if (pipe(cluster.wake) == -1)
+  {
+    fprintf(stderr, "Error in pipe\n");
+    exit(EXIT_FAILURE);
+  }
+  cluster.batches = mcalloc(sizeof(batch_t) * size);
+  for (int i = 0; i < size; i++)
+  {
+    cluster.batches[i].records = mcalloc(sizeof(msg_record_t) * edges);
+    cluster.batches[i].iov = mcalloc(sizeof(struct iovec) * (edges + 2));
+    mutex_init(&cluster.batches[i].mutex);
+  }
+  cluster.satisfied = mcalloc(sizeof(int) * graph->size);
+  cluster.queue = mcalloc(sizeof(int) * graph->size);
+  cluster.head = 0;
+  cluster.length = 0;
+  cluster.loop = 1;
+  cluster.stop = false;
+  cluster.graph = graph;
+  mutex_init(&cluster.mutex);
+  cvar_init(&cluster.cvar);
+}
+
+/*ANCHOR - cluster: push back */
+/* with the cluster mutex locked */
+void cluster_push_back(graph_t *graph, gnode_t *gnode)
+{
+  cluster.queue[(cluster.head + cluster.length) % graph->size] = gnode->id;
+  cluster.length++;
+  cvar_signal(&cluster.cvar);
+}
+
+/*ANCHOR - cluster: stop */
+/* with the cluster mutex locked; the receiver is woken up to exit */
+void cluster_stop(void)
+{
+  char byte = 0;
+
+  cluster.stop = true;
+  cvar_broadcast(&cluster.cvar);
+  if (write(cluster.wake[1], &byte, 1) != 1)
+  {
+    fprintf(stderr, "Error in write\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*ANCHOR - cluster: release */
+/* Update child dependencies; if met, append child to task queue. With the
+   cluster mutex locked. */
+void cluster_release(graph_t *graph, gnode_t *child)
+{
+  if (++cluster.satisfied[child->id] == child->deps.required)
+    cluster_push_back(graph, child);
+}
+
+/*ANCHOR - cluster: send */
+/* Send all the iovecs, also if the socket accepts them partially */
+void impl_cluster_sendmsg(int fd, struct iovec *iov, int count)
+{
+  struct msghdr msg = {0};
+  int max = sysconf(_SC_IOV_MAX);
+
+  while (count > 0)
+  {
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count < max ? count : max;
+    ssize_t sent = sendmsg(fd, &msg, 0);
+    if (sent == -1)
+    {
+      fprintf(stderr, "Error in sendmsg\n");
+      exit(EXIT_FAILURE);
+    }
+    while (count > 0 && (size_t)sent >= iov->iov_len)
+    {
+      sent -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0)
+    {
+      iov->iov_base = (char *)iov->iov_base + sent;
+      iov->iov_len -= sent;
+    }
+  }
+}
+
+/*ANCHOR - cluster: receive */
+void impl_cluster_recv(int fd, void *buffer, size_t size)
+{
+  if (size > 0 && recv(fd, buffer, size, MSG_WAITALL) != (ssize_t)size)
+  {
+    fprintf(stderr, "Error in recv\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*ANCHOR - cluster: message */
+/* Without the cluster mutex locked, as the send may block */
+void cluster_message(int dest, msg_type_t type, int loop)
+{
+  msg_header_t header = {.type = type, .loop = loop, .count = 0};
+  struct iovec iov = {.iov_base = &header, .iov_len = sizeof(header)};
+
+  lock(&cluster.batches[dest].mutex);
+  impl_cluster_sendmsg(cluster.fds[dest], &iov, 1);
+  unlock(&cluster.batches[dest].mutex);
+}
+
+/*ANCHOR - cluster: batch add */
+/* Add the release of the edge parent --> child in the loop to the batch of
+   the cluster node that owns the child. The payload is not copied: the
+   iovec points to the edge buffer. Without the cluster mutex locked. */
+void cluster_batch_add(edge_t *edge, int loop)
+{
+  batch_t *batch = &cluster.batches[edge->child->group];
+
+  lock(&batch->mutex);
+  {
+    int n = batch->header.count++;
+    batch->header.loop = loop;
+    batch->records[n].parent = edge->parent->id;
+    batch->records[n].child = edge->child->id;
+    batch->iov[n + 2].iov_base = edge->buffer;
+    batch->iov[n + 2].iov_len = edge->size;
+  }
+  unlock(&batch->mutex);
+}
+
+/*ANCHOR - cluster: batch flush */
+/* Without the cluster mutex locked, as the sends may block */
+void cluster_batch_flush(void)
+{
+  for (int dest = 0; dest < cluster.size; dest++)
+  {
+    batch_t *batch = &cluster.batches[dest];
+
+    lock(&batch->mutex);
+    int count = batch->header.count;
+    if (count > 0)
+    {
+      batch->header.type = MSG_RELEASE;
+      batch->iov[0].iov_base = &batch->header;
+      batch->iov[0].iov_len = sizeof(msg_header_t);
+      batch->iov[1].iov_base = batch->records;
+      batch->iov[1].iov_len = sizeof(msg_record_t) * count;
+      impl_cluster_sendmsg(cluster.fds[dest], batch->iov, count + 2);
+      batch->header.count = 0;
+    }
+    unlock(&batch->mutex);
+  }
+}
+
+/*ANCHOR - cluster: receive message */
+void cluster_receive(graph_t *graph, int fd)
+{
+  msg_header_t header;
+  msg_record_t *records;
+  struct iovec *iov;
+  struct msghdr msg = {0};
+  size_t bytes = 0;
+
+  impl_cluster_recv(fd, &header, sizeof(header));
+  if (header.type != MSG_RELEASE)
+  {
+    lock(&cluster.mutex);
+    cluster.loop = header.loop;
+    if (header.type == MSG_STOP)
+      cluster_stop();
+    else
+      cluster_push_back(graph, graph->root);
+    unlock(&cluster.mutex);
+    return;
+  }
+
+  records = mcalloc(sizeof(msg_record_t) * header.count);
+  iov = mcalloc(sizeof(struct iovec) * header.count);
+  impl_cluster_recv(fd, records, sizeof(msg_record_t) * header.count);
+
+  /* payloads go straight to the edge buffers */
+  for (int i = 0; i < header.count; i++)
+  {
+    lnode_t *child = graph->nodes[records[i].parent]->children;
+    while (child->gnode->id != records[i].child)
+      child = child->next;
+    iov[i].iov_base = child->edge->buffer;
+    iov[i].iov_len = child->edge->size;
+    bytes += child->edge->size;
+  }
+  msg.msg_iov = iov;
+  msg.msg_iovlen = header.count;
+  if (bytes > 0 && recvmsg(fd, &msg, MSG_WAITALL) != (ssize_t)bytes)
+  {
+    fprintf(stderr, "Error in recvmsg\n");
+    exit(EXIT_FAILURE);
+  }
+
+  lock(&cluster.mutex);
+  cluster.loop = header.loop;
+  for (int i = 0; i < header.count; i++)
+    cluster_release(graph, graph->nodes[records[i].child]);
+  unlock(&cluster.mutex);
+
+  free(records);
+  free(iov);
+}
+
+/*ANCHOR - cluster: loop end */
+/* In the cluster node that owns 'Z', without the cluster mutex locked */
+void cluster_loop_end(graph_t *graph)
+{
+  int dest = -1, loop;
+  msg_type_t type = MSG_LOOP;
+
+  lock(&cluster.mutex);
+  {
+    graph->exec_time[cluster.loop - 1].end = now_ns();
+    LOG_LOOPS ? printf("-- %s end of loop %d\n", graph->name, cluster.loop) : 0;
+
+    if (cluster.loop == graph->loops)
+    {
+      /* stop graph execution */
+      graph->loop = cluster.loop;
+      cluster_stop();
+      type = MSG_STOP;
+    }
+    else
+    {
+      cluster.loop++;
+      LOG_LOOPS ? printf("-- %s start of loop %d\n", graph->name, cluster.loop) : 0;
+      graph->exec_time[cluster.loop - 1].start = now_ns();
+      if (graph->root->group == cluster.id)
+        cluster_push_back(graph, graph->root);
+      else
+        dest = graph->root->group;
+    }
+    loop = cluster.loop;
+  }
+  unlock(&cluster.mutex);
+
+  for (int i = 0; i < cluster.size; i++)
+    if (i != cluster.id && (type == MSG_STOP || i == dest))
+      cluster_message(i, type, loop);
+}
+
+/*ANCHOR - cluster: runner */
+/* Runner thread of a cluster node */
+int cluster_runner(void *arg)
+{
+  graph_t *graph = cluster.graph;
+  context_t context;
+
+  context_init(&context, cluster.id * cluster.runners + *(int *)arg);
+
+  lock(&cluster.mutex);
+  while (!cluster.stop)
+  {
+    if (cluster.length == 0)
+    {
+      /* no more local work: send the batches, then wait */
+      unlock(&cluster.mutex);
+      cluster_batch_flush();
+      lock(&cluster.mutex);
+      while (cluster.length == 0 && !cluster.stop)
+        cvar_wait(&cluster.cvar, &cluster.mutex);
+      continue;
+    }
+
+    gnode_t *gnode = graph->nodes[cluster.queue[cluster.head]];
+    int loop = cluster.loop;
+    cluster.head = (cluster.head + 1) % graph->size;
+    cluster.length--;
+    unlock(&cluster.mutex);
+
+    LOG_RUNNER_TASK ? printf("cluster node %d task %c\n", cluster.id, gnode->label) : 0;
+    task_run(gnode, &context, loop);
+    gnode_output(gnode, loop);
+
+    if (gnode->label == 'Z')
+    {
+      lock(&cluster.mutex);
+      cluster.satisfied[gnode->id] = 0;
+      unlock(&cluster.mutex);
+      cluster_loop_end(graph);
+      lock(&cluster.mutex);
+      continue;
+    }
+
+    /* remote children first, without the cluster mutex */
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+      if (child->gnode->group != cluster.id)
+        cluster_batch_add(child->edge, loop);
+
+    lock(&cluster.mutex);
+    /* reset satisfied dependencies for next loop */
+    cluster.satisfied[gnode->id] = 0;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+      if (child->gnode->group == cluster.id)
+        cluster_release(graph, child->gnode);
+  }
+  unlock(&cluster.mutex);
+
+  context_free(&context);
+  return 0;
+}
+
+/*ANCHOR - cluster: receiver */
+/* Receiver thread of a cluster node: reads the messages from the other
+   cluster nodes until the cluster node stops */
+int cluster_receiver(void *arg)
+{
+  graph_t *graph = (graph_t *)arg;
+  struct pollfd *fds = mcalloc(sizeof(struct pollfd) * (cluster.size + 1));
+  bool stop = false;
+
+  while (!stop)
+  {
+    for (int i = 0; i < cluster.size; i++)
+    {
+      fds[i].fd = cluster.fds[i];
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+    fds[cluster.size].fd = cluster.wake[0];
+    fds[cluster.size].events = POLLIN;
+    fds[cluster.size].revents = 0;
+    if (poll(fds, cluster.size + 1, -1) == -1)
+    {
+      fprintf(stderr, "Error in poll\n");
+      exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < cluster.size; i++)
+      if (fds[i].revents & POLLIN)
+        cluster_receive(graph, fds[i].fd);
+      else if (fds[i].revents & (POLLHUP | POLLERR))
+      {
+        fprintf(stderr, "cluster node %d: connection to %d lost\n", cluster.id, i);
+        exit(EXIT_FAILURE);
+      }
+
+    lock(&cluster.mutex);
+    stop = cluster.stop;
+    unlock(&cluster.mutex);
+  }
+
+  free(fds);
+  return 0;
+}
+
+/*ANCHOR - cluster: executor */
+/* Executor of a cluster node: the receiver and the runners */
+void cluster_executor(graph_t *graph)
+{
+  thrd_t receiver;
+  thrd_t *pool = mcalloc(sizeof(thrd_t) * cluster.runners);
+  int *ids = mcalloc(sizeof(int) * cluster.runners);
+
+  lock(&cluster.mutex);
+  if (graph->root->group == cluster.id)
+    cluster_push_back(graph, graph->root);
+  graph->exec_time[0].start = now_ns();
+  unlock(&cluster.mutex);
+
+  if (thrd_create(&receiver, &cluster_receiver, graph) != thrd_success)
+    exit(EXIT_FAILURE);
+  for (int i = 0; i < cluster.runners; i++)
+  {
+    ids[i] = i;
+    if (thrd_create(&pool[i], &cluster_runner, &ids[i]) != thrd_success)
+      exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < cluster.runners; i++)
+    thrd_join(pool[i], NULL);
+  thrd_join(receiver, NULL);
+
+  free(pool);
+  free(ids);
+}
+
+/*ANCHOR - cluster: tcp pair */
+/* Two ends of a TCP connection over the loopback interface: a listening
+   socket on an ephemeral port, connected and accepted */
+void impl_cluster_tcp_pair(int pair[2])
+{
+  struct sockaddr_in addr = {.sin_family = AF_INET,
+                             .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+                             .sin_port = 0};
+  socklen_t length = sizeof(addr);
+  int one = 1;
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (listener == -1 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(listener, 1) == -1 ||
+      getsockname(listener, (struct sockaddr *)&addr, &length) == -1 ||
+      (pair[0] = socket(AF_INET, SOCK_STREAM, 0)) == -1 ||
+      connect(pair[0], (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      (pair[1] = accept(listener, NULL, NULL)) == -1)
+  {
+    fprintf(stderr, "Error in tcp connection\n");
+    exit(EXIT_FAILURE);
+  }
+  close(listener);
+  setsockopt(pair[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(pair[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/*ANCHOR - cluster: run */
+/* Run the graph the specified number of loops in 'size' cluster nodes of
+   'runners' threads, forked processes connected with Unix socket pairs or
+   TCP. Returns false if a cluster node failed.
+ */
+bool cluster_run(graph_t *graph, int size, int runners, int loops)
+{
+  int **fds = mcalloc(sizeof(int *) * size);
+  int buffer = 1 << 20;
+  bool success = true;
+
+  graph->loops = loops;
+  exec_time_init(graph);
+  partition_multilevel(graph, size);
+  partition_print(graph, size);
+
+  /* full mesh of connections; fds[i][i] is not used */
+  for (int i = 0; i < size; i++)
+  {
+    fds[i] = mcalloc(sizeof(int) * size);
+    fds[i][i] = -1;
+  }
+  for (int i = 0; i < size; i++)
+    for (int j = i + 1; j < size; j++)
+    {
+      int pair[2];
+      if (cluster_tcp)
+        impl_cluster_tcp_pair(pair);
+      else if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1)
+      {
+        fprintf(stderr, "Error in socketpair\n");
+        exit(EXIT_FAILURE);
+      }
+      setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+      setsockopt(pair[1], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+      fds[i][j] = pair[0];
+      fds[j][i] = pair[1];
+    }
+
+  fflush(stdout);
+  for (int i = 0; i < size; i++)
+  {
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+      fprintf(stderr, "Error in fork\n");
+      exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+      cluster_init(graph, i, size, runners, fds[i]);
+      LOG_RUNNER_LIFECYCLE ? printf("cluster node %d start, pid %d\n", i, getpid()) : 0;
+      cluster_executor(graph);
+      if (graph->loop > 0)
+      {
+        /* the cluster node owning 'Z' reports */
+        printf("%s: %d loops, %d cluster nodes of %d runners\n", graph->name,
+               graph->loop, size, runners);
+        exec_time_print(graph);
+      }
+      LOG_RUNNER_LIFECYCLE ? printf("cluster node %d exit\n", i) : 0;
+      fflush(stdout);
+      _exit(EXIT_SUCCESS);
+    }
+  }
+
+  for (int i = 0; i < size; i++)
+    for (int j = 0; j < size; j++)
+      if (fds[i][j] != -1)
+        close(fds[i][j]);
+
+  for (int i = 0; i < size; i++)
+  {
+    int status;
+    if (wait(&status) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+      success = false;
+  }
+
+  for (int i = 0; i < size; i++)
+    free(fds[i]);
+  free(fds);
+
+  return success;
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Distributed executor */
+#pragma endregion
+
+/* SECTION - Level-synchronous executor */
+#pragma region
+/*****************************************************************************
+ *
+ *                      LEVEL-SYNCHRONOUS EXECUTOR (BSP)
+ *
+ *****************************************************************************/
+
+/* In staged graphs, counting the dependencies of each gnode is not required:
+   when all the tasks of a topological level have finished, all the tasks of
+   the next level can start. The levels are computed once; in each level the
+   gnodes are split statically among the runners (gnode k of the level goes
+   to runner k % runners) and a barrier separates one level from the next.
+   There is one synchronisation per level instead of one per edge.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - barrier: struct */
+/* Dissemination barrier: in round r, runner i notifies runner i + 2^r and
+   waits for the notification of runner i - 2^r. After ceil(log2 size) rounds
+   all runners have arrived. Flags alternate between two sets (parity) and
+   change their meaning (sense) every two barriers, so they never have to be
+   reset.
+ */
+typedef struct
+{
+  int size;          /* number of runners */
+  int rounds;        /* ceil(log2 size) */
+  atomic_int *flags; /* 2 x rounds x size */
+} barrier_t;
+
+/*ANCHOR - barrier: runner state */
+typedef struct
+{
+  int parity;
+  int sense;
+} barrier_local_t;
+
+/*ANCHOR - bsp: levels */
+/* gnodes of each topological level */
+typedef struct
+{
+  int count;
+  gnode_t **nodes;
+} bsp_level_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - bsp: graph */
+graph_t *bsp_graph;
+
+/*ANCHOR - bsp: levels */
+bsp_level_t *bsp_levels;
+int bsp_levels_count;
+
+/*ANCHOR - bsp: barrier */
+barrier_t bsp_barrier;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - barrier: init */
+void barrier_init(barrier_t *barrier, int size)
+{
+  barrier->size = size;
+  barrier->rounds = 0;
+  while ((1 << barrier->rounds) < size)
+    barrier->rounds++;
+  barrier->flags = mcalloc(sizeof(atomic_int) * 2 * barrier->rounds * size + 1);
+  for (int i = 0; i < 2 * barrier->rounds * size; i++)
+    atomic_init(&barrier->flags[i], 0);
+}
+
+/*ANCHOR - barrier: wait */
+void barrier_wait(barrier_t *barrier, int id, barrier_local_t *local)
+{
+  atomic_int *flags = barrier->flags + local->parity * barrier->rounds * barrier->size;
+
+  for (int r = 0; r < barrier->rounds; r++)
+  {
+    int partner = (id + (1 << r)) % barrier->size;
+    atomic_store(&flags[r * barrier->size + partner], !local->sense);
+    while (atomic_load(&flags[r * barrier->size + id]) == local->sense)
+      thrd_yield();
+  }
+  if (local->parity == 1)
+    local->sense = !local->sense;
+  local->parity = 1 - local->parity;
+}
+
+/*ANCHOR - bsp: init */
+void bsp_init(graph_t *graph, int runners, int loops)
+{
+  bsp_graph = graph;
+  graph->loops = loops;
+  exec_time_init(graph);
+
+  bsp_levels_count = graph->levels;
+  bsp_levels = mcalloc(sizeof(bsp_level_t) * bsp_levels_count);
+  for (int l = 0; l < bsp_levels_count; l++)
+    bsp_levels[l].nodes = mcalloc(sizeof(gnode_t *) * graph->size);
+  for (int i = 0; i < graph->size; i++)
+  {
+    bsp_level_t *level = &bsp_levels[graph->nodes[i]->level];
+    level->nodes[level->count++] = graph->nodes[i];
+  }
+
+  barrier_init(&bsp_barrier, runners);
+}
+
+/*ANCHOR - bsp: runner */
+int runner_bsp(void *arg)
+{
+  int id = *(int *)arg;
+  graph_t *graph = bsp_graph;
+  barrier_local_t local = {.parity = 0, .sense = 0};
+  context_t context;
+
+  LOG_RUNNER_LIFECYCLE ? printf("runner %d start\n", id) : 0;
+  context_init(&context, id);
+  atomic_fetch_add(&runners_count, 1);
+
+  for (int loop = 1; loop <= graph->loops; loop++)
+  {
+    if (id == 0)
+    {
+      graph->loop = loop;
+      LOG_LOOPS ? printf("-- %s start of loop %d\n", graph->name, loop) : 0;
+      graph->exec_time[loop - 1].start = now_ns();
+      exec_trace_reset(graph);
+    }
+
+    for (int l = 0; l < bsp_levels_count; l++)
+    {
+      for (int k = id; k < bsp_levels[l].count; k += bsp_barrier.size)
+      {
+        gnode_t *gnode = bsp_levels[l].nodes[k];
+        LOG_RUNNER_TASK ? printf("runner %d task %c\n", id, gnode->label) : 0;
+        exec_trace_append(graph, gnode->label);
+        task_run(gnode, &context, loop);
+        gnode_output(gnode, loop);
+        exec_trace_append(graph, gnode->label);
+      }
+      barrier_wait(&bsp_barrier, id, &local);
+    }
+
+    if (id == 0)
+    {
+      graph->exec_time[loop - 1].end = now_ns();
+      LOG_LOOPS ? printf("-- %s end of loop %d\n", graph->name, loop) : 0;
+      LOG_EXEC_TRACE ? printf("%s exec trace: %s\n", graph->name, graph->exec_trace) : 0;
+    }
+  }
+
+  context_free(&context);
+  LOG_RUNNER_LIFECYCLE ? printf("runner %d exit\n", id) : 0;
+  return 0;
+}
+
+/*ANCHOR - bsp: run */
+void bsp_run(graph_t *graph, int runners, int loops)
+{
+  thrd_t *pool = mcalloc(sizeof(thrd_t) * runners);
+  int *ids = mcalloc(sizeof(int) * runners);
+
+  bsp_init(graph, runners, loops);
+  atomic_init(&runners_count, 0);
+  for (int i = 0; i < runners; i++)
+  {
+    ids[i] = i;
+    if (thrd_create(&pool[i], &runner_bsp, &ids[i]) != thrd_success)
+      exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < runners; i++)
+    thrd_join(pool[i], NULL);
+
+  printf("%s: %d loops, %d levels, %d barriers per loop\n", graph->name,
+         graph->loop, bsp_levels_count, bsp_levels_count);
+  free(pool);
+  free(ids);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Level-synchronous executor */
+#pragma endregion
+
+/* SECTION - Pipelined executor */
+#pragma region
+/*****************************************************************************
+ *
+ *                           PIPELINED EXECUTOR
+ *
+ *****************************************************************************/
+
+/* Up to 'depth' loops of the graph are in flight: a loop starts as soon as
+   the oldest loop in flight has finished, and the tasks of different loops
+   run at the same time. The dependencies of each gnode are counted per loop,
+   in the slot 'loop % depth'. The buffer of each edge has K versions, used
+   by loop 'loop % K', so that a parent in loop N + 1 doesn't overwrite the
+   buffer its child in loop N is still reading. A producer is stalled only
+   when the version of one of its output edges has not been consumed yet,
+   which can't happen when K >= depth; stalled producers don't hold a runner,
+   wait in a list of the edge and are enqueued again when the child of the
+   edge releases a version.
+
+   A gnode is ready at most once per loop, so the ready tasks are items of a
+   pool of 'depth' x graph size, indexed like the dependencies, in a list
+   per loop in flight: the oldest ready task is found in O(depth).
+
+   A delay edge parent --> child of distance d adds a dependency of the child
+   in loop N + d on the parent in loop N. If the parent finishes before loop
+   N + d has started, the satisfied dependency is carried in a ring of
+   'depth + max delay' loops, subtracted when the loop starts.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - pipeline: task */
+typedef struct pipeline_item
+{
+  gnode_t *gnode;
+  int epoch;                 /* loop of the task, from 1 */
+  struct pipeline_item *next; /* in a ready list or a stalled list */
+} pipeline_item_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - pipeline: graph */
+graph_t *pipeline_graph;
+
+/*ANCHOR - pipeline: depth and versions */
+int pipeline_depth;          /* max loops in flight */
+int pipeline_versions;       /* buffers of each edge */
+
+/*ANCHOR - pipeline: loops */
+int *pipeline_pending;       /* unmet dependencies, depth x graph size */
+bool *pipeline_done;         /* loops finished, by epoch % depth */
+int pipeline_started;        /* last loop started */
+int pipeline_retired;        /* loops 1 to pipeline_retired have finished */
+
+/*ANCHOR - pipeline: delay edges */
+int *pipeline_carried;       /* satisfied delays of loops not yet started */
+int pipeline_carried_loops;  /* depth + max delay */
+
+/*ANCHOR - pipeline: tasks */
+pipeline_item_t *pipeline_items;   /* a task per gnode, depth x graph size */
+pipeline_item_t **pipeline_ready;  /* ready-to-run tasks, by epoch % depth */
+int pipeline_ready_count;
+long pipeline_stalls;
+mtx_t pipeline_mtx;
+cnd_t pipeline_cvar;
+
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - pipeline: init */
+void pipeline_init(graph_t *graph, int depth, int versions, int loops)
+{
+  pipeline_graph = graph;
+  pipeline_depth = depth;
+  pipeline_versions = versions;
+  graph->loops = loops;
+  exec_time_init(graph);
+
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+    {
+      edge_t *edge = child->edge;
+      free(edge->buffer);
+      edge->buffer = edge->size > 0 ? mcalloc(edge->size * versions) : NULL;
+      edge->versions = versions;
+      edge->released = mcalloc(sizeof(long) * versions);
+    }
+
+  pipeline_carried_loops = depth;
+  for (int i = 0; i < graph->size; i++)
+    for (lnode_t *delay = graph->nodes[i]->delays_out; delay != NULL; delay = delay->next)
+      if (depth + delay->edge->delay > pipeline_carried_loops)
+        pipeline_carried_loops = depth + delay->edge->delay;
+  pipeline_carried = mcalloc(sizeof(int) * pipeline_carried_loops * graph->size);
+
+  pipeline_pending = mcalloc(sizeof(int) * depth * graph->size);
+  pipeline_done = mcalloc(sizeof(bool) * depth);
+  pipeline_started = 0;
+  pipeline_retired = 0;
+  pipeline_items = mcalloc(sizeof(pipeline_item_t) * depth * graph->size);
+  pipeline_ready = mcalloc(sizeof(pipeline_item_t *) * depth);
+  pipeline_ready_count = 0;
+  pipeline_stalls = 0;
+  mutex_init(&pipeline_mtx);
+  cvar_init(&pipeline_cvar);
+}
+
+/*ANCHOR - pipeline: requeue */
+/* with the pipeline mutex locked */
+void impl_pipeline_requeue(pipeline_item_t *item)
+{
+  item->next = pipeline_ready[item->epoch % pipeline_depth];
+  pipeline_ready[item->epoch % pipeline_depth] = item;
+  pipeline_ready_count++;
+}
+
+/*ANCHOR - pipeline: push */
+/* with the pipeline mutex locked */
+void impl_pipeline_push(gnode_t *gnode, int epoch)
+{
+  pipeline_item_t *item =
+      &pipeline_items[(epoch % pipeline_depth) * pipeline_graph->size + gnode->id];
+
+  item->gnode = gnode;
+  item->epoch = epoch;
+  impl_pipeline_requeue(item);
+}
+
+/*ANCHOR - pipeline: pop */
+/* Tasks of the oldest loops first; with the pipeline mutex locked */
+pipeline_item_t *impl_pipeline_pop(void)
+{
+  for (int epoch = pipeline_retired + 1; epoch <= pipeline_started; epoch++)
+  {
+    pipeline_item_t *item = pipeline_ready[epoch % pipeline_depth];
+    if (item != NULL)
+    {
+      pipeline_ready[epoch % pipeline_depth] = item->next;
+      pipeline_ready_count--;
+      return item;
+    }
+  }
+  return NULL;
+}
+
+/*ANCHOR - pipeline: writable */
+/* The versions of the output edges used by the loop have been consumed by
+   the children in the loop 'epoch - K'. Returns the first edge not yet
+   consumed, or NULL; with the pipeline mutex locked */
+edge_t *impl_pipeline_unwritable(gnode_t *gnode, int epoch)
+{
+  for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+    if (child->edge->size > 0 &&
+        child->edge->released[epoch % pipeline_versions] < epoch - pipeline_versions)
+      return child->edge;
+  return NULL;
+}
+
+/*ANCHOR - pipeline: stall */
+/* The producer waits for the edge; with the pipeline mutex locked */
+bool impl_pipeline_stall(pipeline_item_t *item)
+{
+  edge_t *edge = impl_pipeline_unwritable(item->gnode, item->epoch);
+
+  if (edge == NULL)
+    return false;
+  item->next = edge->stalled;
+  edge->stalled = item;
+  return true;
+}
+
+/*ANCHOR - pipeline: start loops */
+/* Start new loops while there is room in the pipeline; with the pipeline
+   mutex locked */
+void impl_pipeline_start(void)
+{
+  graph_t *graph = pipeline_graph;
+
+  while (pipeline_started < graph->loops &&
+         pipeline_started < pipeline_retired + pipeline_depth)
+  {
+    int epoch = ++pipeline_started;
+    int *pending = pipeline_pending + (epoch % pipeline_depth) * graph->size;
+    int *carried = pipeline_carried + (epoch % pipeline_carried_loops) * graph->size;
+
+    LOG_LOOPS ? printf("-- %s start of loop %d\n", graph->name, epoch) : 0;
+    pipeline_done[epoch % pipeline_depth] = false;
+    graph->exec_time[epoch - 1].start = now_ns();
+    for (int i = 0; i < graph->size; i++)
+    {
+      gnode_t *gnode = graph->nodes[i];
+      pending[i] = gnode->deps.required - carried[i];
+      carried[i] = 0;
+      for (lnode_t *delay = gnode->delays_in; delay != NULL; delay = delay->next)
+        if (epoch - delay->edge->delay >= 1)
+          pending[i]++;
+      if (pending[i] == 0)
+        impl_pipeline_push(gnode, epoch);
+    }
+  }
+}
+
+/*ANCHOR - pipeline: runner */
+int runner_pipeline(void *arg)
+{
+  int id = *(int *)arg;
+  graph_t *graph = pipeline_graph;
+  context_t context;
+
+  LOG_RUNNER_LIFECYCLE ? printf("runner %d start\n", id) : 0;
+  context_init(&context, id);
+  atomic_fetch_add(&runners_count, 1);
+
+  lock(&pipeline_mtx);
+  while (true)
+  {
+    while (pipeline_ready_count == 0 && pipeline_retired < graph->loops)
+      cvar_wait(&pipeline_cvar, &pipeline_mtx);
+    if (pipeline_retired == graph->loops)
+      break;
+
+    pipeline_item_t *item = impl_pipeline_pop();
+    gnode_t *gnode = item->gnode;
+    int epoch = item->epoch;
+    if (impl_pipeline_stall(item))
+    {
+      pipeline_stalls++;
+      continue;
+    }
+    unlock(&pipeline_mtx);
+
+    LOG_RUNNER_TASK ? printf("runner %d task %c loop %d\n", id, gnode->label, epoch) : 0;
+    task_run(gnode, &context, epoch);
+    gnode_output(gnode, epoch);
+
+    lock(&pipeline_mtx);
+
+    /* the inputs have been consumed, the producers stalled on them may
+       write them, or wait for another of their edges */
+    for (lnode_t *parent = gnode->parents; parent != NULL; parent = parent->next)
+    {
+      pipeline_item_t *stalled = parent->edge->stalled;
+      parent->edge->released[epoch % pipeline_versions] = epoch;
+      parent->edge->stalled = NULL;
+      while (stalled != NULL)
+      {
+        pipeline_item_t *next = stalled->next;
+        if (!impl_pipeline_stall(stalled))
+          impl_pipeline_requeue(stalled);
+        stalled = next;
+      }
+    }
+
+    int *pending = pipeline_pending + (epoch % pipeline_depth) * graph->size;
+    for (lnode_t *child = gnode->children; child != NULL; child = child->next)
+      if (--pending[child->gnode->id] == 0)
+        impl_pipeline_push(child->gnode, epoch);
+
+    /* loop-carried dependencies */
+    for (lnode_t *delay = gnode->delays_out; delay != NULL; delay = delay->next)
+    {
+      int later = epoch + delay->edge->delay;
+      if (later > graph->loops)
+        continue;
+      if (later > pipeline_started)
+        pipeline_carried[(later % pipeline_carried_loops) * graph->size + delay->gnode->id]++;
+      else if (--pipeline_pending[(later % pipeline_depth) * graph->size + delay->gnode->id] == 0)
+        impl_pipeline_push(delay->gnode, later);
+    }
+
+    if (gnode->label == 'Z')
+    {
+      graph->exec_time[epoch - 1].end = now_ns();
+      LOG_LOOPS ? printf("-- %s end of loop %d\n", graph->name, epoch) : 0;
+      pipeline_done[epoch % pipeline_depth] = true;
+      while (pipeline_retired < pipeline_started &&
+             pipeline_done[(pipeline_retired + 1) % pipeline_depth])
+        pipeline_retired++;
+      impl_pipeline_start();
+    }
+
+    cvar_broadcast(&pipeline_cvar);
+  }
+  unlock(&pipeline_mtx);
+  cvar_broadcast(&pipeline_cvar);
+
+  context_free(&context);
+  LOG_RUNNER_LIFECYCLE ? printf("runner %d exit\n", id) : 0;
+  return 0;
+}
+
+/*ANCHOR - pipeline: run */
+void pipeline_run(graph_t *graph, int runners, int depth, int versions, int loops)
+{
+  thrd_t *pool = mcalloc(sizeof(thrd_t) * runners);
+  int *ids = mcalloc(sizeof(int) * runners);
+
+  pipeline_init(graph, depth, versions, loops);
+  lock(&pipeline_mtx);
+  impl_pipeline_start();
+  unlock(&pipeline_mtx);
+
+  atomic_init(&runners_count, 0);
+  for (int i = 0; i < runners; i++)
+  {
+    ids[i] = i;
+    if (thrd_create(&pool[i], &runner_pipeline, &ids[i]) != thrd_success)
+      exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < runners; i++)
+    thrd_join(pool[i], NULL);
+
+  long elapsed = graph->exec_time[loops - 1].end - graph->exec_time[0].start;
+  graph->loop = loops;
+  printf("%s: %d loops, depth %d, %d versions, %ld producer stalls, %.2f loops/s\n",
+         graph->name, loops, depth, versions, pipeline_stalls, loops * 1e9 / elapsed);
+
+  free(pool);
+  free(ids);
+  free(pipeline_items);
+  free(pipeline_ready);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Pipelined executor */
+#pragma endregion
+
+/* SECTION - Tasks implementation */
+#pragma region
+/*****************************************************************************
+ *
+ *                            TASKS IMPLEMENTATION
+ *
+ *****************************************************************************/
+
+/*ANCHOR - task: initial (A) */
+/* Loops are counted by the runners, see #LINK - runner: loop start */
+void task_A(context_t *context)
+{
+  (void)context;
+}
+
+/*ANCHOR - task: final (Z) */
+void task_Z(context_t *context)
+{
+  (void)context;
+}
+
+/* SECTION - Synthetic tasks */
+/* Sleeping tasks do not consume CPU, so they hide the contention between
+   runners: oversubscribed cores, shared caches and memory bandwidth. The
+   other kinds of simulated tasks keep the CPU busy for the duration of the
+   task, using a kernel calibrated at startup:
+     - spin: compute-bound loop, no memory accesses
+     - stream: memory-bandwidth bound, a[i] = b[i] + s * c[i] over the working
+       set
+     - chase: latency bound, pointer chasing over a random cycle of cache
+       lines in the working set
+   Each runner has its own working set, of the size given with -S.
+ */
+
+/*ANCHOR - tasks: kind */
+typedef enum
+{
+  TASK_SLEEP,
+  TASK_SPIN,
+  TASK_STREAM,
+  TASK_CHASE
+} task_kind_t;
+
+/*ANCHOR - tasks: cache line */
+typedef struct
+{
+  long next;
+  char padding[64 - sizeof(long)];
+} cache_line_t;
+
+/*ANCHOR - tasks: working set */
+typedef struct
+{
+  long n;              /* elements in each stream array */
+  double *a, *b, *c;   /* stream arrays */
+  long lines;          /* cache lines in the pointer chasing cycle */
+  cache_line_t *cycle;
+  long position;       /* current cache line in the cycle */
+} working_set_t;
+
+/*ANCHOR - tasks: settings */
+task_kind_t tasks_kind = TASK_SLEEP;
+size_t tasks_working_set = 4 << 20;
+
+/*ANCHOR - tasks: calibration */
+/* Work done per ns by each kernel: spin iterations, stream elements and
+   chase hops */
+double tasks_per_ns[4];
+
+/*ANCHOR - tasks: runner working set */
+_Thread_local working_set_t *working_set = NULL;
+
+/*ANCHOR - tasks: sink */
+/* Keeps the compiler from removing the kernels */
+_Thread_local volatile uint64_t kernel_sink;
+
+/*ANCHOR - tasks: working set init */
+working_set_t *working_set_new(size_t size)
+{
+  working_set_t *ws = mcalloc(sizeof(working_set_t));
+
+  ws->n = size / (3 * sizeof(double));
+  ws->a = mcalloc(sizeof(double) * ws->n);
+  ws->b = mcalloc(sizeof(double) * ws->n);
+  ws->c = mcalloc(sizeof(double) * ws->n);
+  for (long i = 0; i < ws->n; i++)
+  {
+    ws->b[i] = i;
+    ws->c[i] = 1.0 / (i + 1);
+  }
+
+  /* random cycle over all the cache lines (Sattolo's algorithm) */
+  ws->lines = size / sizeof(cache_line_t);
+  ws->cycle = mcalloc(sizeof(cache_line_t) * ws->lines);
+  for (long i = 0; i < ws->lines; i++)
+    ws->cycle[i].next = i;
+  for (long i = ws->lines - 1; i > 0; i--)
+  {
+    long j = random_next() % i;
+    long tmp = ws->cycle[i].next;
+    ws->cycle[i].next = ws->cycle[j].next;
+    ws->cycle[j].next = tmp;
+  }
+  ws->position = 0;
+
+  return ws;
+}
+
+/*ANCHOR - tasks: kernel spin */
+void kernel_spin(long iterations)
+{
+  uint64_t x = 88172645463325252UL;
+
+  for (long i = 0; i < iterations; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  kernel_sink = x;
+}
+
+/*ANCHOR - tasks: kernel stream */
+void kernel_stream(working_set_t *ws, long elements)
+{
+  while (elements > 0)
+  {
+    long n = elements < ws->n ? elements : ws->n;
+    for (long i = 0; i < n; i++)
+      ws->a[i] = ws->b[i] + 3.0 * ws->c[i];
+    elements -= n;
+  }
+  kernel_sink = (uint64_t)ws->a[ws->n / 2];
+}
+
+/*ANCHOR - tasks: kernel chase */
+void kernel_chase(working_set_t *ws, long hops)
+{
+  long position = ws->position;
+
+  for (long i = 0; i < hops; i++)
+    position = ws->cycle[position].next;
+  ws->position = position;
+  kernel_sink = position;
+}
+
+/*ANCHOR - tasks: kernel run */
+void kernel_run(task_kind_t kind, long work)
+{
+  if (kind != TASK_SPIN && working_set == NULL)
+    working_set = working_set_new(tasks_working_set);
+
+  switch (kind)
+  {
+  case TASK_SPIN:
+    kernel_spin(work);
+    break;
+  case TASK_STREAM:
+    kernel_stream(working_set, work);
+    break;
+  case TASK_CHASE:
+    kernel_chase(working_set, work);
+    break;
+  default:
+    break;
+  }
+}
+
+/*ANCHOR - tasks: calibrate */
+/* Measure the work done per ns by the kernel of the selected kind: the
+   amount of work is doubled until the kernel runs for at least 20 ms. */
+void tasks_calibrate(void)
+{
+  long work = 1024, elapsed = 0;
+
+  if (tasks_kind == TASK_SLEEP)
+    return;
+
+  kernel_run(tasks_kind, work); /* warm up the working set */
+  while (elapsed < 20000000L)
+  {
+    work *= 2;
+    long start = now_ns();
+    kernel_run(tasks_kind, work);
+    elapsed = now_ns() - start;
+  }
+  tasks_per_ns[tasks_kind] = (double)work / elapsed;
+
+  printf("tasks calibrated: %.3f %s per ns, working set %zu KiB\n",
+         tasks_per_ns[tasks_kind],
+         tasks_kind == TASK_SPIN     ? "iterations"
+         : tasks_kind == TASK_STREAM ? "elements"
+                                     : "hops",
+         tasks_working_set >> 10);
+}
+
+/*ANCHOR - tasks: simulate */
+/* Simulate a task of the given duration */
+void task_simulate(long nsec)
+{
+  if (tasks_kind == TASK_SLEEP)
+  {
+    struct timespec time = {.tv_sec = nsec / 1000000000L,
+                            .tv_nsec = nsec % 1000000000L};
+    thrd_sleep(&time, NULL);
+  }
+  else
+    kernel_run(tasks_kind, (long)(nsec * tasks_per_ns[tasks_kind]));
+}
+/*!SECTION - Synthetic tasks */
+
+/*ANCHOR - tasks: macro generator */
+#define GENERATE_TASK(NAME, MS)                             \
+  void task_##NAME(context_t *context)                      \
+  {                                                         \
+    long nsec = MS * 1000000L;                              \
+    if (TASK_JITTER)                                        \
+      nsec += (1 - (long)(random_next() % 3)) *             \
+              (long)(random_next() % (nsec / 10));          \
+    task_scratch(context);                                  \
+    task_simulate(nsec);                                    \
+  }
+
+/*ANCHOR - tasks: scratch */
+/* With scratch arenas, a task works on a temporary buffer of the size of its
+   output, see #LINK - Scratch arenas */
+void task_scratch(context_t *context)
+{
+  size_t size = context->gnode != NULL && context->gnode->payload > 0
+                    ? context->gnode->payload
+                    : 1024;
+
+  if (context->scratch.base != NULL)
+    memset(scratch_alloc(context, size), 0, size);
+}
+
+/*ANCHOR - tasks: instantiation */
+GENERATE_TASK(a, 100);
+GENERATE_TASK(b, 200);
+GENERATE_TASK(c, 100);
+GENERATE_TASK(1, 20);
+GENERATE_TASK(2, 50);
+GENERATE_TASK(3, 50);
+GENERATE_TASK(4, 100);
+GENERATE_TASK(i, 100);
+GENERATE_TASK(j, 80);
+GENERATE_TASK(k, 50);
+GENERATE_TASK(x, 50);
+GENERATE_TASK(y, 100);
+
+/* nodes of the wide graph */
+GENERATE_TASK(w, 10);
+
+/*!SECTION - Tasks implementation */
+#pragma endregion
+
+/* SECTION - Graph example */
+#pragma region
+/*****************************************************************************
+ *
+ *                              GRAPH EXAMPLE
+ *
+ *****************************************************************************/
+
+/*ANCHOR - graph example: constructor */
+/* The DAG of the figure graph.excalidraw.png */
+graph_t *graph_example_new(const char *name)
+{
+  graph_t *graph = graph_new(name);
+  gnode_t *root, *gnode, *end;
+
+  /* Initial and final nodes */
+  root = gnode_new(graph, 'A', task_A);
+  end = gnode_new(graph, 'Z', task_Z);
+
+  /* A --> { a, b, c } */
+  gnode_child_new(root, 'a', task_a);
+  gnode_child_new(root, 'b', task_b);
+  gnode_child_new(root, 'c', task_c);
+
+  /* a --> { 1, 2 } */
+  gnode = gnode_get(root, 'a');
+  gnode_child_new(gnode, '1', task_1);
+  gnode_child_new(gnode, '2', task_2);
+
+  /* b --> { 2 } */
+  gnode = gnode_get(root, 'b');
+  gnode_child(gnode, gnode_get(root, '2'));
+
+  /* c -> { 3, 4 } */
+  gnode = gnode_get(root, 'c');
+  gnode_child_new(gnode, '3', task_3);
+  gnode_child_new(gnode, '4', task_4);
+
+  /* 1 --> { i, j } */
+  gnode = gnode_get(root, '1');
+  gnode_child_new(gnode, 'i', task_i);
+  gnode_child_new(gnode, 'j', task_j);
+
+  /* 2 --> { k } */
+  gnode = gnode_get(root, '2');
+  gnode_child_new(gnode, 'k', task_k);
+
+  /* 3 --> { k } */
+  gnode = gnode_get(root, '3');
+  gnode_child(gnode, gnode_get(root, 'k'));
+
+  /* 4 --> { Z } */
+  gnode = gnode_get(root, '4');
+  gnode_child(gnode, end);
+
+  /* i --> { x } */
+  gnode = gnode_get(root, 'i');
+  gnode_child_new(gnode, 'x', task_x);
+
+  /* j --> { x, y } */
+  gnode = gnode_get(root, 'j');
+  gnode_child(gnode, gnode_get(root, 'x'));
+  gnode_child_new(gnode, 'y', task_y);
+
+  /* k --> { y } */
+  gnode = gnode_get(root, 'k');
+  gnode_child(gnode, gnode_get(root, 'y'));
+
+  /* x --> { Z } */
+  gnode = gnode_get(root, 'x');
+  gnode_child(gnode, end);
+
+  /* y --> { Z } */
+  gnode = gnode_get(root, 'y');
+  gnode_child(gnode, end);
+
+  /* Payloads: a frame from A, raw sensor data from the first stage, smaller
+     filtered and fused data from the next stages */
+  for (int i = 0; i < graph->size; i++)
+  {
+    gnode = graph->nodes[i];
+    if (gnode == root)
+      gnode->payload = 16384;
+    else if (gnode->parents->gnode == root)
+      gnode->payload = 8192;
+    else if (gnode != end)
+      gnode->payload = 2048;
+  }
+
+  return graph;
+}
+
+/*ANCHOR - graph example: wide graph */
+/* Wide and shallow graph: 'depth' levels of 'width' nodes. The root is the
+   parent of the first level, node i of a level is the parent of nodes i to
+   i + fanin - 1 of the next level, and the last level are the parents of Z.
+ */
+graph_t *graph_wide_new(const char *name, int width, int depth, int fanin)
+{
+  graph_t *graph = graph_new(name);
+  gnode_t *root = gnode_new(graph, 'A', task_A);
+  gnode_t *end = gnode_new(graph, 'Z', task_Z);
+  gnode_t **prev = mcalloc(sizeof(gnode_t *) * width);
+  gnode_t **next = mcalloc(sizeof(gnode_t *) * width);
+
+  for (int i = 0; i < width; i++)
+    prev[i] = gnode_child_new(root, 'w', task_w);
+
+  for (int d = 1; d < depth; d++)
+  {
+    for (int i = 0; i < width; i++)
+    {
+      next[i] = gnode_child_new(prev[i], 'w', task_w);
+      for (int k = 1; k < fanin && k <= i; k++)
+        gnode_child(prev[i - k], next[i]);
+    }
+    memcpy(prev, next, sizeof(gnode_t *) * width);
+  }
+
+  for (int i = 0; i < width; i++)
+    gnode_child(prev[i], end);
+
+  free(prev);
+  free(next);
+  return graph;
+}
+/*!SECTION - Graph example */
+#pragma endregion
+
+/* SECTION - Static executor */
+#pragma region
+/*****************************************************************************
+ *
+ *                  CODE GENERATOR AND STATIC EXECUTOR
+ *
+ *****************************************************************************/
+
+/* For a fixed graph, the generic runners chase the lists of children and
+   call the tasks through pointers. A static graph is declared in a C file
+   with X-macros, written by hand or by graph_codegen:
+     #define STATIC_NAME "graph-0"
+     #define STATIC_TASKS(X) X(0, A, 0) X(1, a, 1) ... X(13, Z, 4)
+     #define STATIC_CHILDREN_0(X) X(0, 1) X(0, 2) ...
+     ...
+     #define STATIC_CHILDREN_13(X)
+     #define STATIC_PARENTS_0(X)
+     #define STATIC_PARENTS_1(X) X(0, 1)
+     ...
+     #define STATIC_PARENTS_13(X) X(9, 13) X(10, 13) ...
+     #define STATIC_EDGES(X) STATIC_CHILDREN_0(X) ... STATIC_CHILDREN_13(X)
+   where ids are in topological order, each task 'label' is the function
+   task_label with the given number of parents, and STATIC_CHILDREN_id and
+   STATIC_PARENTS_id list the edges from and to the task 'id'. The compiler
+   checks the graph (an edge from a task to an earlier one would close a
+   cycle, the parents of each task must be its edges), derives the
+   dependencies of each task from its parents and a dispatch function that
+   calls each task directly and releases each of its children. Each macro is
+   expanded a constant number of times, so building a graph takes time
+   linear in its size, and nothing is checked or built at startup. Built with
+   the file,
+     gcc graph.c -O3 -DGRAPH_STATIC='"graph_static.h"' -o graph
+   the static executor (-m static) runs the graph with runners that only pop
+   the index of the next task and dispatch it. Tasks have no edge buffers.
+ */
+
+/* SECTION - Functions */
+
+/*ANCHOR - codegen: write */
+void graph_codegen(graph_t *graph, const char *path)
+{
+  FILE *file = fopen(path, "w");
+  int edges = 0;
+
+  if (file == NULL)
+  {
+    fprintf(stderr, "Error in fopen %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  graph_order_compact(graph);
+  for (int i = 0; i < graph->size; i++)
+  {
+    if (graph->nodes[i]->delays_out != NULL)
+    {
+      fprintf(stderr, "Error in graph %s: delay edges can't be generated\n",
+              graph->name);
+      exit(EXIT_FAILURE);
+    }
+    for (lnode_t *child = graph->nodes[i]->children; child != NULL; child = child->next)
+      edges++;
+  }
+
+  fprintf(file, "/* Generated by graph -E from %s: %d tasks, %d edges.\n"
+                "   See #LINK - Static executor */\n",
+          graph->name, graph->size, edges);
+  fprintf(file, "#define STATIC_NAME \"%s\"\n\n", graph->name);
+
+  fprintf(file, "/* tasks in topological order: X(id, label, parents) */\n");
+  fprintf(file, "#define STATIC_TASKS(X) \\\n");
+  for (int i = 0; i < graph->size; i++)
+    fprintf(file, "  X(%d, %c, %d)%s\n", i, graph->order[i]->label,
+            graph->order[i]->deps.required, i < graph->size - 1 ? " \\" : "");
+
+  fprintf(file, "\n/* edges from each task: X(parent, child) */\n");
+  for (int i = 0; i < graph->size; i++)
+  {
+    fprintf(file, "#define STATIC_CHILDREN_%d(X)", i);
+    for (lnode_t *child = graph->order[i]->children; child != NULL; child = child->next)
+      fprintf(file, " X(%d, %d)", i, child->gnode->position);
+    fprintf(file, "\n");
+  }
+
+  fprintf(file, "\n/* edges to each task: X(parent, child) */\n");
+  for (int i = 0; i < graph->size; i++)
+  {
+    fprintf(file, "#define STATIC_PARENTS_%d(X)", i);
+    for (lnode_t *parent = graph->order[i]->parents; parent != NULL; parent = parent->next)
+      fprintf(file, " X(%d, %d)", parent->gnode->position, i);
+    fprintf(file, "\n");
+  }
+
+  fprintf(file, "\n/* all edges */\n");
+  fprintf(file, "#define STATIC_EDGES(X) \\\n");
+  for (int i = 0; i < graph->size; i++)
+    fprintf(file, "  STATIC_CHILDREN_%d(X)%s\n", i, i < graph->size - 1 ? " \\" : "");
+
+  fclose(file);
+  printf("%s: %d tasks, %d edges generated in %s\n", graph->name, graph->size,
+         edges, path);
+}
+
+#ifdef GRAPH_STATIC
+
+/*ANCHOR - static: variables */
+graph_t *static_graph;          /* loops and their execution time */
+atomic_int *static_satisfied;   /* parents finished in the current loop */
+int *static_queue;              /* ready tasks, at most all of them */
+int static_head;
+int static_length;
+bool static_active;
+mtx_t static_mtx;
+cnd_t static_cvar;
+
+/*ANCHOR - static: push */
+void static_push(int id)
+{
+  lock(&static_mtx);
+  {
+    static_queue[(static_head + static_length++) % static_graph->size] = id;
+  }
+  unlock(&static_mtx);
+  cvar_signal(&static_cvar);
+}
+
+/*ANCHOR - static: release */
+void static_release(int child, int required)
+{
+  if (atomic_fetch_add_explicit(&static_satisfied[child], 1, memory_order_acq_rel) + 1 ==
+      required)
+    static_push(child);
+}
+
+/*ANCHOR - static: loop start */
+void static_loop_start(void)
+{
+  static_graph->loop++;
+  static_graph->exec_time[static_graph->loop - 1].start = now_ns();
+  static_push(0);
+}
+
+/*ANCHOR - static: loop end */
+/* Called by the runner of the last task */
+void static_loop_end(void)
+{
+  static_graph->exec_time[static_graph->loop - 1].end = now_ns();
+  if (static_graph->loop < static_graph->loops)
+  {
+    static_loop_start();
+    return;
+  }
+
+  printf("%s: %d loops\n", static_graph->name, static_graph->loop);
+  lock(&static_mtx);
+  static_active = false;
+  unlock(&static_mtx);
+  cvar_broadcast(&static_cvar);
+}
+
+#include GRAPH_STATIC
+
+/*ANCHOR - static: size */
+#define STATIC_COUNT(id, label, parents) +1
+#define STATIC_ONE(parent, child) +1
+enum
+{
+  STATIC_SIZE = 0 STATIC_TASKS(STATIC_COUNT),
+  STATIC_EDGES_COUNT = 0 STATIC_EDGES(STATIC_ONE)
+};
+
+/*ANCHOR - static: checks */
+/* Ids are in topological order, so the graph is acyclic; the switch of
+   #LINK - static: dispatch rejects duplicated ids. Task 0 is the only task
+   without parents, and a single task has no children. The parents declared
+   for each task are the edges of its STATIC_PARENTS_id list, and each list
+   only has edges of its task: the sum of their ends and of their squares
+   are those of n times the same id. The lists of parents have the same edges
+   as the lists of children, as far as the sums of the edge keys and of
+   their squares tell. */
+#define STATIC_PARENT(parent, child) +(long long)(parent)
+#define STATIC_PARENT_SQUARE(parent, child) +(long long)(parent) * (parent)
+#define STATIC_CHILD(parent, child) +(long long)(child)
+#define STATIC_CHILD_SQUARE(parent, child) +(long long)(child) * (child)
+#define STATIC_KEY(parent, child) ((unsigned long long)(parent) * STATIC_SIZE + (child) + 1)
+#define STATIC_KEY_SUM(parent, child) +STATIC_KEY(parent, child)
+#define STATIC_KEY_SQUARE(parent, child) +STATIC_KEY(parent, child) * STATIC_KEY(parent, child)
+
+#define STATIC_CHECK_TASK(id, label, parents)                              \
+  _Static_assert((id) >= 0 && (id) < STATIC_SIZE, "static task " #label ": id out of range"); \
+  _Static_assert(((parents) == 0) == ((id) == 0),                          \
+                 "static task " #label ": only the root has no parents");  \
+  _Static_assert((0 STATIC_PARENTS_##id(STATIC_ONE)) == (parents),         \
+                 "static task " #label ": parents do not match its edges"); \
+  _Static_assert((0 STATIC_PARENTS_##id(STATIC_CHILD)) == (long long)(parents) * (id) && \
+                 (0 STATIC_PARENTS_##id(STATIC_CHILD_SQUARE)) ==           \
+                 (long long)(parents) * (id) * (id),                       \
+                 "static task " #label ": edge to another task in its parents"); \
+  _Static_assert((0 STATIC_CHILDREN_##id(STATIC_PARENT)) ==                \
+                 (0 STATIC_CHILDREN_##id(STATIC_ONE)) * (long long)(id) && \
+                 (0 STATIC_CHILDREN_##id(STATIC_PARENT_SQUARE)) ==         \
+                 (0 STATIC_CHILDREN_##id(STATIC_ONE)) * (long long)(id) * (id), \
+                 "static task " #label ": edge from another task in its children");
+#define STATIC_CHECK_EDGE(parent, child)                         \
+  _Static_assert((parent) >= 0 && (parent) < (child) && (child) < STATIC_SIZE, \
+                 "static edge " #parent " -> " #child ": not in topological order");
+#define STATIC_DECLARED(id, label, parents) +(parents)
+#define STATIC_IN_SUM(id, label, parents) STATIC_PARENTS_##id(STATIC_KEY_SUM)
+#define STATIC_IN_SQUARE(id, label, parents) STATIC_PARENTS_##id(STATIC_KEY_SQUARE)
+#define STATIC_END(id, label, parents) +((0 STATIC_CHILDREN_##id(STATIC_ONE)) == 0)
+
+STATIC_TASKS(STATIC_CHECK_TASK)
+STATIC_EDGES(STATIC_CHECK_EDGE)
+_Static_assert((0 STATIC_TASKS(STATIC_DECLARED)) == STATIC_EDGES_COUNT,
+               "static graph: parents of the tasks do not match the edges");
+_Static_assert((0ULL STATIC_TASKS(STATIC_IN_SUM)) == (0ULL STATIC_EDGES(STATIC_KEY_SUM)) &&
+                   (0ULL STATIC_TASKS(STATIC_IN_SQUARE)) ==
+                       (0ULL STATIC_EDGES(STATIC_KEY_SQUARE)),
+               "static graph: lists of parents and children do not match");
+_Static_assert((0 STATIC_TASKS(STATIC_END)) == 1, "static graph: more than one end");
+
+/*ANCHOR - static: tables */
+/* The dependencies of each task are counted from its list of parents */
+#define STATIC_LABEL(id, label, parents) [id] = #label,
+#define STATIC_REQUIRED(id, label, parents) [id] = 0 STATIC_PARENTS_##id(STATIC_ONE),
+
+const char *static_labels[STATIC_SIZE] = {STATIC_TASKS(STATIC_LABEL)};
+const int static_required[STATIC_SIZE] = {STATIC_TASKS(STATIC_REQUIRED)};
+
+/*ANCHOR - static: dispatch */
+/* Run a task and release its children; each case expands only the edges of
+   its task */
+#define STATIC_RELEASE(parent, child) static_release(child, static_required[child]);
+#define STATIC_DISPATCH(id, label, parents)          \
+  case id:                                           \
+    task_##label(context);                           \
+    STATIC_CHILDREN_##id(STATIC_RELEASE)             \
+    if ((0 STATIC_CHILDREN_##id(STATIC_ONE)) == 0)   \
+      static_loop_end();                             \
+    break;
+
+void static_dispatch(int id, context_t *context)
+{
+  switch (id)
+  {
+    STATIC_TASKS(STATIC_DISPATCH)
+  }
+}
+
+/*ANCHOR - static: runner */
+int runner_static(void *arg)
+{
+  context_t context;
+
+  context_init(&context, *(int *)arg);
+
+  while (true)
+  {
+    lock(&static_mtx);
+    while (static_length == 0 && static_active)
+      cvar_wait(&static_cvar, &static_mtx);
+    if (!static_active)
+    {
+      unlock(&static_mtx);
+      break;
+    }
+    int id = static_queue[static_head];
+    static_head = (static_head + 1) % static_graph->size;
+    static_length--;
+    unlock(&static_mtx);
+
+    LOG_RUNNER_TASK ? printf("static runner task %s\n", static_labels[id]) : 0;
+    /* reset satisfied dependencies for next loop */
+    atomic_store_explicit(&static_satisfied[id], 0, memory_order_relaxed);
+    scratch_begin(&context, static_graph, static_graph->loop);
+    static_dispatch(id, &context);
+  }
+
+  context_free(&context);
+  return 0;
+}
+
+/*ANCHOR - static: run */
+graph_t *static_run(int runners, int loops)
+{
+  thrd_t *pool = mcalloc(sizeof(thrd_t) * runners);
+  int *ids = mcalloc(sizeof(int) * runners);
+
+  static_graph = graph_new(STATIC_NAME);
+  static_graph->size = STATIC_SIZE;
+  static_graph->loops = loops;
+  exec_time_init(static_graph);
+  static_satisfied = mcalloc(sizeof(atomic_int) * STATIC_SIZE);
+  for (int i = 0; i < STATIC_SIZE; i++)
+    atomic_init(&static_satisfied[i], 0);
+  static_queue = mcalloc(sizeof(int) * STATIC_SIZE);
+  static_head = 0;
+  static_length = 0;
+  static_active = true;
+  mutex_init(&static_mtx);
+  cvar_init(&static_cvar);
+
+  for (int i = 0; i < runners; i++)
+  {
+    ids[i] = i;
+    if (thrd_create(&pool[i], &runner_static, &ids[i]) != thrd_success)
+      exit(EXIT_FAILURE);
+  }
+  static_loop_start();
+  for (int i = 0; i < runners; i++)
+    thrd_join(pool[i], NULL);
+
+  free(pool);
+  free(ids);
+  free(static_satisfied);
+  free(static_queue);
+  return static_graph;
+}
+
+#endif /* GRAPH_STATIC */
+
+/*!SECTION - Functions */
+/*!SECTION - Static executor */
+#pragma endregion
+
+/* SECTION - Microbenchmarks */
+#pragma region
+/*****************************************************************************
+ *
+ *                  MICROBENCHMARKS OF THE RUNTIME PRIMITIVES
+ *
+ *****************************************************************************/
+
+/* Cost of the building blocks of the pool of runners, measured on the very
+   functions the runners use, with 1 to N threads:
+     - queue: a thread pushes a gnode with task_queue_push_back and pops one
+       with task_queue_pop_front, holding the lock as a runner does
+     - release: each thread releases the edges from its gnode to the same
+       children with runner_process_children, with the counters and with the
+       bitset engine; the children never get ready
+     - trace: the threads append the labels of a loop with exec_trace_append
+     - wakeup: from the start of a loop to the start of its root task by one
+       of the sleeping runners
+     - dispatch: empty tasks of a wide graph run by the runners; the time of
+       the runners outside the task bodies and the waits for tasks, per task
+     - call: a task called through a function pointer ('fn'), or as a task
+       object wrapping the function ('task') or capturing state ('capture'),
+       by a single thread
+     - ready: the ready test of the readiness bitset on parents masks of 1 to
+       32 words, with each implementation the CPU supports, by a single
+       thread; all the parents are done, so the whole mask is tested
+     - ring: a producer pushes frames in a ring of a stream and a consumer
+       pops them, with the latency from push to pop
+   Each result is a line of JSON on the standard output, e.g.
+     {"bench":"queue","threads":2,"ops":200000,"ns_per_op":...}
+   where ns_per_op is the time spent in each operation by a thread, and
+   ops_per_s the throughput of all the threads.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - bench: thread */
+typedef struct
+{
+  int id;
+  long ops;     /* operations measured */
+  long ns;      /* time spent in the measured operations */
+  long push_ns; /* queue: time spent pushing */
+} bench_thread_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - bench: operations */
+/* Operations of each thread in the queue and release benchmarks */
+long bench_ops = 100000;
+
+/*ANCHOR - bench: samples */
+/* Loops started in the wakeup benchmark */
+int bench_samples = 2000;
+
+/*ANCHOR - bench: wide graph */
+/* Graph of the trace and dispatch benchmarks */
+int bench_width = 64;
+int bench_depth = 8;
+int bench_loops = 50;
+
+/*ANCHOR - bench: children */
+/* Children released by each gnode in the release benchmark */
+int bench_children = 16;
+
+/*ANCHOR - bench: ring */
+/* Frames of the ring of the ring benchmark */
+int bench_ring_capacity = 64;
+ring_t *bench_ring;
+long *bench_latency;
+
+/*ANCHOR - bench: state */
+int bench_threads;       /* threads of the running benchmark */
+graph_t *bench_graph;    /* graph of the running benchmark */
+barrier_t bench_barrier; /* start of the threads, rounds of the trace */
+atomic_int bench_done;   /* end of the loop run by the runners */
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - bench: print */
+/* 'ns' is the total time spent in 'ops' operations by all the threads */
+void impl_bench_print(const char *bench, long ops, long ns, long elapsed,
+                      const char *extra)
+{
+  printf("{\"bench\":\"%s\",\"threads\":%d,\"ops\":%ld,\"ns_per_op\":%.1f,"
+         "\"ops_per_s\":%.0f%s}\n",
+         bench, bench_threads, ops, (double)ns / ops, ops / (elapsed / 1e9), extra);
+  fflush(stdout);
+}
+
+/*ANCHOR - bench: run threads */
+/* Run 'body' in all the threads; returns the elapsed time */
+long impl_bench_run(thrd_start_t body, bench_thread_t *threads)
+{
+  thrd_t *pool = mcalloc(sizeof(thrd_t) * bench_threads);
+  long start = now_ns();
+
+  barrier_init(&bench_barrier, bench_threads);
+  for (int i = 0; i < bench_threads; i++)
+  {
+    threads[i] = (bench_thread_t){.id = i};
+    if (thrd_create(&pool[i], body, &threads[i]) != thrd_success)
+      exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < bench_threads; i++)
+    thrd_join(pool[i], NULL);
+
+  free(bench_barrier.flags);
+  free(pool);
+  return now_ns() - start;
+}
+
+/*ANCHOR - bench: register */
+/* The graph is the only one seen by the queue and the runners */
+void impl_bench_register(graph_t *graph)
+{
+  graph_register(graph);
+  bench_graph = graph;
+}
+
+/*ANCHOR - bench: unregister */
+void impl_bench_unregister(void)
+{
+  graph_free(bench_graph);
+  free(graphs);
+  graphs = NULL;
+  graphs_count = 0;
+  tasks_queue_init();
+}
+
+/*ANCHOR - bench: quiescent */
+/* Wait for the runners to end their tasks, see #LINK - Hot-swap */
+void impl_bench_quiescent(void)
+{
+  for (int i = 0; i < runners_pool_size; i++)
+    while (atomic_load(&rcu_epochs[i]) % 2 != 0)
+      thrd_yield();
+}
+
+/*ANCHOR - bench: queue */
+int impl_bench_queue(void *arg)
+{
+  bench_thread_t *thread = (bench_thread_t *)arg;
+  barrier_local_t local = {.parity = 0, .sense = 0};
+
+  barrier_wait(&bench_barrier, thread->id, &local);
+  for (long i = 0; i < bench_ops; i++)
+  {
+    long start = now_ns();
+    task_queue_push_back(bench_graph->root);
+    long pushed = now_ns();
+    lock(&tasks_queue_mtx);
+    task_queue_pop_front(thread->id % tasks_queue_groups);
+    unlock(&tasks_queue_mtx);
+    thread->push_ns += pushed - start;
+    thread->ns += now_ns() - pushed;
+  }
+  thread->ops = bench_ops;
+
+  return 0;
+}
+
+/*ANCHOR - bench: release */
+int impl_bench_release(void *arg)
+{
+  bench_thread_t *thread = (bench_thread_t *)arg;
+  barrier_local_t local = {.parity = 0, .sense = 0};
+  gnode_t *gnode = bench_graph->nodes[1 + thread->id];
+  long calls = bench_ops / bench_children;
+
+  barrier_wait(&bench_barrier, thread->id, &local);
+  long start = now_ns();
+  for (long i = 0; i < calls; i++)
+    runner_process_children(gnode);
+  thread->ns = now_ns() - start;
+  thread->ops = calls * bench_children;
+
+  return 0;
+}
+
+/*ANCHOR - bench: ring */
+/* Thread 0 pushes the frames and thread 1 pops them; only the calls that
+   succeed are timed, and a thread yields when the ring is full or empty */
+int impl_bench_ring(void *arg)
+{
+  bench_thread_t *thread = (bench_thread_t *)arg;
+  barrier_local_t local = {.parity = 0, .sense = 0};
+  frame_t frame = {.seq = 0, .time = 0, .data = NULL};
+
+  barrier_wait(&bench_barrier, thread->id, &local);
+  while (frame.seq < bench_ops)
+  {
+    long start = now_ns();
+    if (thread->id == 0)
+    {
+      frame.time = start;
+      if (!ring_push(bench_ring, frame))
+      {
+        thrd_yield();
+        continue;
+      }
+      thread->push_ns += now_ns() - start;
+      frame.seq++;
+    }
+    else
+    {
+      if (!ring_pop(bench_ring, &frame))
+      {
+        thrd_yield();
+        continue;
+      }
+      long end = now_ns();
+      thread->ns += end - start;
+      bench_latency[frame.seq++] = end - frame.time;
+    }
+  }
+  thread->ops = bench_ops;
+
+  return 0;
+}
+
+/*ANCHOR - bench: trace */
+/* In each round the threads append the labels of a loop */
+int impl_bench_trace(void *arg)
+{
+  bench_thread_t *thread = (bench_thread_t *)arg;
+  barrier_local_t local = {.parity = 0, .sense = 0};
+  int labels = 2 * bench_graph->size / bench_threads;
+
+  for (int r = 0; r < bench_loops; r++)
+  {
+    barrier_wait(&bench_barrier, thread->id, &local);
+    long start = now_ns();
+    for (int i = 0; i < labels; i++)
+      exec_trace_append(bench_graph, 'w');
+    thread->ns += now_ns() - start;
+    thread->ops += labels;
+    barrier_wait(&bench_barrier, thread->id, &local);
+    if (thread->id == 0)
+      exec_trace_reset(bench_graph);
+  }
+
+  return 0;
+}
+
+/*ANCHOR - bench: tasks */
+/* Root task of the wakeup benchmark */
+void impl_bench_wakeup_task(context_t *context)
+{
+  (void)context;
+  bench_graph->exec_time[bench_graph->loop - 1].end = now_ns();
+  atomic_store(&bench_done, 1);
+}
+
+/* End task of the dispatch benchmark */
+void impl_bench_end_task(context_t *context)
+{
+  (void)context;
+  atomic_store(&bench_done, 1);
+}
+
+/*ANCHOR - bench: calls */
+/* The same work called as a function and as a task capturing state */
+long bench_counter;
+task_fn_t bench_fn;
+task_t bench_task;
+
+void impl_bench_count(context_t *context)
+{
+  (void)context;
+  bench_counter++;
+}
+
+void impl_bench_capture(void *storage, context_t *context)
+{
+  struct
+  {
+    long *counter;
+    long step;
+  } *captures = storage;
+
+  (void)context;
+  *captures->counter += captures->step;
+}
+
+/*ANCHOR - bench: call */
+void impl_bench_call(void)
+{
+  struct
+  {
+    long *counter;
+    long step;
+  } captures = {&bench_counter, 1};
+  long ops = bench_ops * 100;
+  long start;
+  context_t context;
+
+  bench_threads = 1;
+  context_init(&context, 0);
+  bench_fn = impl_bench_count;
+  start = now_ns();
+  for (long i = 0; i < ops; i++)
+    bench_fn(&context);
+  impl_bench_print("call_fn", ops, now_ns() - start, now_ns() - start, "");
+
+  bench_task = task_fn(impl_bench_count);
+  start = now_ns();
+  for (long i = 0; i < ops; i++)
+    task_call(&bench_task, &context);
+  impl_bench_print("call_task", ops, now_ns() - start, now_ns() - start, "");
+
+  bench_task = task_capture(impl_bench_capture, captures);
+  start = now_ns();
+  for (long i = 0; i < ops; i++)
+    task_call(&bench_task, &context);
+  impl_bench_print("call_capture", ops, now_ns() - start, now_ns() - start, "");
+  context_free(&context);
+}
+
+/*ANCHOR - bench: ready test */
+void impl_bench_ready(void)
+{
+  struct
+  {
+    const char *name;
+    bool (*test)(const uint64_t *parents, const uint64_t *done, int words);
+  } impls[3] = {{"scalar", impl_bitset_ready_scalar}};
+  int count = 1;
+  uint64_t parents[32], done[32];
+  char extra[64];
+
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2"))
+    impls[count++] = (typeof(impls[0])){"avx2", impl_bitset_ready_avx2};
+  if (__builtin_cpu_supports("avx512f"))
+    impls[count++] = (typeof(impls[0])){"avx512", impl_bitset_ready_avx512};
+#endif
+  for (int i = 0; i < 32; i++)
+  {
+    parents[i] = 0x5555555555555555UL;
+    done[i] = ~0UL;
+  }
+
+  bench_threads = 1;
+  for (int words = 1; words <= 32; words *= 2)
+    for (int i = 0; i < count; i++)
+    {
+      bool (*volatile test)(const uint64_t *, const uint64_t *, int) = impls[i].test;
+      long ops = bench_ops * 10, ready = 0;
+      long start = now_ns();
+      for (long op = 0; op < ops; op++)
+        ready += test(parents, done, words);
+      long ns = now_ns() - start;
+      if (ready != ops)
+        exit(EXIT_FAILURE);
+      snprintf(extra, sizeof(extra), ",\"words\":%d,\"impl\":\"%s\"", words,
+               impls[i].name);
+      impl_bench_print("ready", ops, ns, ns, extra);
+    }
+}
+
+/*ANCHOR - bench: empty graph */
+/* Wide graph of empty tasks; its end is not 'Z', so the runners do not
+   start the next loop: see #LINK - bench: loop */
+graph_t *impl_bench_graph(int width, int depth, int loops)
+{
+  graph_t *graph = graph_wide_new("bench", width, depth, 1);
+
+  for (int i = 0; i < graph->size; i++)
+    graph->nodes[i]->task = task_fn(task_A);
+  graph->nodes[1]->label = 'z';
+  graph->nodes[1]->task = task_fn(impl_bench_end_task);
+  impl_bench_register(graph);
+  graph->loops = loops;
+  exec_time_init(graph);
+
+  return graph;
+}
+
+/*ANCHOR - bench: loop */
+/* Run a loop of the graph with the runners, without ending the graph */
+void impl_bench_loop(void)
+{
+  atomic_store(&bench_done, 0);
+  runner_loop_start(bench_graph, now_ns());
+  while (!atomic_load(&bench_done))
+    thrd_yield();
+  impl_bench_quiescent();
+}
+
+/*ANCHOR - bench: latency compare */
+int impl_bench_compare(const void *a, const void *b)
+{
+  long x = *(const long *)a, y = *(const long *)b;
+
+  return (x > y) - (x < y);
+}
+
+/*ANCHOR - bench: run */
+/* Run all the benchmarks with 1 to 'threads' threads */
+void bench_run(int threads)
+{
+  bench_thread_t *results = mcalloc(sizeof(bench_thread_t) * threads);
+  long *latency = mcalloc(sizeof(long) * bench_samples);
+  char extra[160];
+  long elapsed, ns, ops, push_ns;
+
+  impl_bench_call();
+  impl_bench_ready();
+
+  /* ring: a single producer and a single consumer */
+  bench_threads = 2;
+  bench_ring = ring_new(bench_ring_capacity);
+  bench_latency = mcalloc(sizeof(long) * bench_ops);
+  results = mrealloc(results, sizeof(bench_thread_t) * (threads > 2 ? threads : 2));
+  elapsed = impl_bench_run(&impl_bench_ring, results);
+  qsort(bench_latency, bench_ops, sizeof(long), impl_bench_compare);
+  snprintf(extra, sizeof(extra),
+           ",\"push_ns\":%.1f,\"pop_ns\":%.1f,\"p50_ns\":%ld,\"p99_ns\":%ld",
+           (double)results[0].push_ns / bench_ops, (double)results[1].ns / bench_ops,
+           bench_latency[bench_ops / 2], bench_latency[bench_ops * 99 / 100]);
+  impl_bench_print("ring", 2 * bench_ops, results[0].push_ns + results[1].ns,
+                   elapsed, extra);
+  free(bench_ring->frames);
+  free(bench_ring);
+  free(bench_latency);
+
+  for (bench_threads = 1; bench_threads <= threads; bench_threads++)
+  {
+    /* queue */
+    graph_t *graph = graph_new("bench");
+    gnode_new(graph, 'A', task_A);
+    impl_bench_register(graph);
+    elapsed = impl_bench_run(&impl_bench_queue, results);
+    ns = push_ns = ops = 0;
+    for (int i = 0; i < bench_threads; i++)
+    {
+      ns += results[i].ns;
+      push_ns += results[i].push_ns;
+      ops += results[i].ops;
+    }
+    snprintf(extra, sizeof(extra), ",\"push_ns\":%.1f,\"pop_ns\":%.1f",
+             (double)push_ns / ops, (double)ns / ops);
+    impl_bench_print("queue", 2 * ops, ns + push_ns, elapsed, extra);
+    impl_bench_unregister();
+
+    /* release: the root is the parent of a gnode per thread, parents of
+       the same children; the root, never released, is also a parent of the
+       children, so that they never get ready */
+    for (int bitset = 0; bitset <= 1; bitset++)
+    {
+      graph = graph_new("bench");
+      gnode_t *root = gnode_new(graph, 'A', task_A);
+      for (int i = 0; i < bench_threads; i++)
+        gnode_child_new(root, 'p', task_A);
+      for (int c = 0; c < bench_children; c++)
+      {
+        gnode_t *child = gnode_child_new(graph->nodes[1], 'c', task_A);
+        for (int i = 1; i < bench_threads; i++)
+          gnode_child(graph->nodes[1 + i], child);
+        gnode_child(root, child);
+      }
+      impl_bench_register(graph);
+      if (bitset)
+        bitset_init(graph);
+      for (int i = 1 + bench_threads; i < graph->size; i++)
+        graph->nodes[i]->deps.required = INT_MAX;
+      elapsed = impl_bench_run(&impl_bench_release, results);
+      ns = ops = 0;
+      for (int i = 0; i < bench_threads; i++)
+      {
+        ns += results[i].ns;
+        ops += results[i].ops;
+      }
+      snprintf(extra, sizeof(extra), ",\"engine\":\"%s\"",
+               graph->bitset != NULL ? "bitset" : "counters");
+      impl_bench_print("release", ops, ns, elapsed, extra);
+      impl_bench_unregister();
+    }
+
+    /* trace */
+    impl_bench_register(graph_wide_new("bench", bench_width, bench_depth, 1));
+    elapsed = impl_bench_run(&impl_bench_trace, results);
+    ns = ops = 0;
+    for (int i = 0; i < bench_threads; i++)
+    {
+      ns += results[i].ns;
+      ops += results[i].ops;
+    }
+    snprintf(extra, sizeof(extra), ",\"trace\":%d", 2 * bench_graph->size);
+    impl_bench_print("trace", ops, ns, elapsed, extra);
+    impl_bench_unregister();
+
+    /* wakeup: a loop of a single task, started once the runners sleep */
+    graph = graph_new("bench");
+    gnode_new(graph, 'A', impl_bench_wakeup_task);
+    impl_bench_register(graph);
+    graph->loops = bench_samples;
+    exec_time_init(graph);
+    runners_init_pool(bench_threads);
+    elapsed = 0;
+    for (int s = 0; s < bench_samples; s++)
+    {
+      struct timespec time = {.tv_sec = 0, .tv_nsec = 20000};
+      thrd_sleep(&time, NULL);
+      impl_bench_loop();
+      latency[s] = graph->exec_time[s].end - graph->exec_time[s].start;
+      elapsed += latency[s];
+    }
+    runners_stop();
+    runners_join();
+    runners_free();
+    qsort(latency, bench_samples, sizeof(long), impl_bench_compare);
+    snprintf(extra, sizeof(extra), ",\"p50_ns\":%ld,\"p99_ns\":%ld,\"max_ns\":%ld",
+             latency[bench_samples / 2], latency[bench_samples * 99 / 100],
+             latency[bench_samples - 1]);
+    impl_bench_print("wakeup", bench_samples, elapsed, elapsed, extra);
+    impl_bench_unregister();
+
+    /* dispatch: empty tasks, timed by the runners */
+    graph = impl_bench_graph(bench_width, bench_depth, bench_loops);
+    runners_timed = true;
+    runners_init_pool(bench_threads);
+    elapsed = now_ns();
+    for (int l = 0; l < bench_loops; l++)
+      impl_bench_loop();
+    elapsed = now_ns() - elapsed;
+    runners_stop();
+    runners_join();
+    ns = ops = 0;
+    for (int i = 0; i < bench_threads; i++)
+    {
+      ns += runners_time[i].ns;
+      ops += runners_time[i].tasks;
+    }
+    runners_free();
+    runners_timed = false;
+    impl_bench_print("dispatch", ops, ns, elapsed, "");
+    impl_bench_unregister();
+  }
+
+  free(results);
+  free(latency);
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Microbenchmarks */
+#pragma endregion
+
+/* SECTION - Benchmark harness */
+#pragma region
+/*****************************************************************************
+ *
+ *                  STATISTICAL BENCHMARK REGRESSION HARNESS
+ *
+ *****************************************************************************/
+
+/* Each scenario (a graph of empty tasks run by the pool of runners) is run a
+   number of repetitions, each one with a new pool of runners:
+     - warm-up: loops are run in windows until the mean duration of a window
+       is within a tolerance of the previous one (steady state)
+     - measure: the mean of the next loops gives a sample of the makespan of
+       a loop and the throughput in tasks per second; the runners add up
+       their time outside the task bodies and the waits for tasks, which
+       gives the overhead per task (dispatch, release and queue)
+   The samples of the repetitions give the mean and its 95% confidence
+   interval. The results are printed as lines of JSON; when a baseline of a
+   previous run is given, each metric is compared with a Welch's t-test, and
+   significant changes to the worse beyond the tolerance are flagged as
+   regressions. Without a baseline file, it is created with the results.
+ */
+
+/* SECTION - Types */
+
+/*ANCHOR - harness: statistics */
+typedef struct
+{
+  int n;
+  double mean;
+  double sd; /* sample standard deviation */
+} stats_t;
+
+/*ANCHOR - harness: scenario */
+typedef struct
+{
+  const char *name;
+  int width;
+  int depth;
+} scenario_t;
+
+/*ANCHOR - harness: metric */
+typedef enum
+{
+  METRIC_MAKESPAN,   /* ns per loop, lower is better */
+  METRIC_THROUGHPUT, /* tasks per second, higher is better */
+  METRIC_OVERHEAD,   /* runner ns per task outside its body, lower is better */
+  METRIC_COUNT
+} metric_t;
+/*!SECTION - Types */
+
+/* SECTION - Variables */
+
+/*ANCHOR - harness: scenarios */
+/* A wide graph stresses the queue and the release of the children; a chain
+   stresses the wakeup of the runners */
+scenario_t harness_scenarios[] = {
+    {"wide-64x8", 64, 8},
+    {"chain-256", 1, 256},
+};
+int harness_scenarios_count = sizeof(harness_scenarios) / sizeof(scenario_t);
+
+/*ANCHOR - harness: metrics */
+const char *harness_metrics[METRIC_COUNT] = {"makespan_ns", "throughput",
+                                             "overhead_ns"};
+
+/*ANCHOR - harness: windows */
+/* Loops of a warm-up window, max warm-up windows, and measured loops */
+int harness_window = 5;
+int harness_windows = 20;
+int harness_loops = 20;
+
+/*ANCHOR - harness: tolerance */
+/* Relative change between two warm-up windows in steady state, and min
+   relative change of a regression */
+double harness_tolerance = 0.05;
+
+/*ANCHOR - harness: t distribution */
+/* Two-sided 95% critical values of the Student's t distribution, for 1 to
+   30 degrees of freedom */
+double harness_t95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                        2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+                        2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+                        2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048,
+                        2.045, 2.042};
+/*!SECTION - Variables */
+
+/* SECTION - Functions */
+
+/*ANCHOR - harness: square root */
+/* Newton's method, to build without the math library */
+double impl_stats_sqrt(double x)
+{
+  double y = x > 1 ? x : 1;
+
+  if (x <= 0)
+    return 0;
+  for (int i = 0; i < 64; i++)
+  {
+    double next = (y + x / y) / 2;
+    if (next == y)
+      break;
+    y = next;
+  }
+  return y;
+}
+
+/*ANCHOR - harness: statistics */
+stats_t stats_compute(const double *samples, int n)
+{
+  stats_t stats = {.n = n, .mean = 0, .sd = 0};
+
+  for (int i = 0; i < n; i++)
+    stats.mean += samples[i] / n;
+  for (int i = 0; i < n && n > 1; i++)
+    stats.sd += (samples[i] - stats.mean) * (samples[i] - stats.mean) / (n - 1);
+  stats.sd = impl_stats_sqrt(stats.sd);
+
+  return stats;
+}
+
+/*ANCHOR - harness: critical value */
+double stats_t95(double df)
+{
+  if (df < 1)
+    return harness_t95[0];
+  if (df <= 30)
+    return harness_t95[(int)df - 1];
+  return df <= 60 ? 2.000 : df <= 120 ? 1.980 : 1.960;
+}
+
+/*ANCHOR - harness: confidence interval */
+/* Half width of the 95% confidence interval of the mean */
+double stats_ci95(stats_t stats)
+{
+  if (stats.n < 2)
+    return 0;
+  return stats_t95(stats.n - 1) * stats.sd / impl_stats_sqrt(stats.n);
+}
+
+/*ANCHOR - harness: Welch's t-test */
+/* Returns true if the means differ significantly (95%). The t statistic and
+   the Welch-Satterthwaite degrees of freedom are returned in 't' and 'df'.
+ */
+bool stats_welch(stats_t a, stats_t b, double *t, double *df)
+{
+  double va = a.n > 0 ? a.sd * a.sd / a.n : 0;
+  double vb = b.n > 0 ? b.sd * b.sd / b.n : 0;
+
+  *t = 0;
+  *df = 0;
+  if (a.n < 2 || b.n < 2 || va + vb == 0)
+    return a.mean != b.mean;
+  *t = (a.mean - b.mean) / impl_stats_sqrt(va + vb);
+  *df = (va + vb) * (va + vb) / (va * va / (a.n - 1) + vb * vb / (b.n - 1));
+  return *t > stats_t95(*df) || -*t > stats_t95(*df);
+}
+
+/*ANCHOR - harness: mean loop */
+/* Mean duration of the loops 'first' to 'last' - 1 */
+double impl_harness_mean(graph_t *graph, int first, int last)
+{
+  double mean = 0;
+
+  for (int l = first; l < last; l++)
+    mean += (double)(graph->exec_time[l].end - graph->exec_time[l].start) /
+            (last - first);
+  return mean;
+}
+
+/*ANCHOR - harness: repetition */
+/* One repetition of the scenario; the samples of the metrics are stored in
+   'samples' and the number of warm-up loops is returned. */
+int impl_harness_repetition(scenario_t *scenario, int runners, double *samples)
+{
+  graph_t *graph = impl_bench_graph(scenario->width, scenario->depth,
+                                    harness_window * harness_windows + harness_loops);
+  double previous = 0;
+  int warmup = 0;
+
+  runners_init_pool(runners);
+  for (int w = 0; w < harness_windows; w++)
+  {
+    for (int l = 0; l < harness_window; l++)
+    {
+      impl_bench_loop();
+      graph->exec_time[warmup].end = now_ns();
+      warmup++;
+    }
+    double mean = impl_harness_mean(graph, warmup - harness_window, warmup);
+    if (w > 0 && mean < previous * (1 + harness_tolerance) &&
+        mean > previous * (1 - harness_tolerance))
+      break;
+    previous = mean;
+  }
+
+  /* the runners are idle between loops */
+  memset(runners_time, 0, sizeof(runner_time_t) * runners);
+  for (int l = 0; l < harness_loops; l++)
+  {
+    impl_bench_loop();
+    graph->exec_time[warmup + l].end = now_ns();
+  }
+  runners_stop();
+  runners_join();
+
+  long ns = 0, tasks = 0;
+  for (int i = 0; i < runners; i++)
+  {
+    ns += runners_time[i].ns;
+    tasks += runners_time[i].tasks;
+  }
+  runners_free();
+
+  double makespan = impl_harness_mean(graph, warmup, warmup + harness_loops);
+  samples[METRIC_MAKESPAN] = makespan;
+  samples[METRIC_THROUGHPUT] = graph->size / (makespan / 1e9);
+  samples[METRIC_OVERHEAD] = tasks > 0 ? (double)ns / tasks : 0;
+  impl_bench_unregister();
+
+  return warmup;
+}
+
+/*ANCHOR - harness: baseline */
+/* Statistics of a metric in a baseline file written by #LINK - harness: run */
+bool impl_harness_baseline(FILE *file, const char *scenario, int runners,
+                           const char *metric, stats_t *stats)
+{
+  char line[512], name[32], key[32];
+  int threads;
+
+  if (file == NULL)
+    return false;
+  rewind(file);
+  while (fgets(line, sizeof(line), file) != NULL)
+    if (sscanf(line, "{\"scenario\":\"%31[^\"]\",\"threads\":%d,\"metric\":\"%31[^\"]\","
+                     "\"n\":%d,\"mean\":%lf,\"sd\":%lf",
+               name, &threads, key, &stats->n, &stats->mean, &stats->sd) == 6 &&
+        strcmp(name, scenario) == 0 && threads == runners && strcmp(key, metric) == 0)
+      return true;
+  return false;
+}
+
+/*ANCHOR - harness: run */
+/* Run all the scenarios with 'reps' repetitions. Returns false if there is a
+   regression with respect to the baseline. */
+bool harness_run(int reps, int runners, const char *baseline)
+{
+  FILE *file = baseline != NULL ? fopen(baseline, "r") : NULL;
+  FILE *output = NULL;
+  double *samples = mcalloc(sizeof(double) * METRIC_COUNT * reps);
+  double *metric = mcalloc(sizeof(double) * reps);
+  bool success = true;
+
+  runners_timed = true;
+  if (baseline != NULL && file == NULL && (output = fopen(baseline, "w")) == NULL)
+  {
+    fprintf(stderr, "Error in fopen %s\n", baseline);
+    exit(EXIT_FAILURE);
+  }
+
+  for (int s = 0; s < harness_scenarios_count; s++)
+  {
+    scenario_t *scenario = &harness_scenarios[s];
+    long warmup = 0;
+
+    for (int r = 0; r < reps; r++)
+      warmup += impl_harness_repetition(scenario, runners, samples + r * METRIC_COUNT);
+
+    for (int m = 0; m < METRIC_COUNT; m++)
+    {
+      char result[256], extra[256] = "";
+      stats_t base;
+
+      for (int r = 0; r < reps; r++)
+        metric[r] = samples[r * METRIC_COUNT + m];
+      stats_t stats = stats_compute(metric, reps);
+      snprintf(result, sizeof(result),
+               "{\"scenario\":\"%s\",\"threads\":%d,\"metric\":\"%s\",\"n\":%d,"
+               "\"mean\":%.1f,\"sd\":%.1f,\"ci95\":%.1f,\"warmup\":%.1f",
+               scenario->name, runners, harness_metrics[m], stats.n, stats.mean,
+               stats.sd, stats_ci95(stats), (double)warmup / reps);
+
+      if (impl_harness_baseline(file, scenario->name, runners, harness_metrics[m], &base))
+      {
+        double t, df;
+        double change = (stats.mean - base.mean) / base.mean;
+        bool worse = m == METRIC_THROUGHPUT ? change < -harness_tolerance
+                                            : change > harness_tolerance;
+        bool regression = stats_welch(stats, base, &t, &df) && worse;
+        snprintf(extra, sizeof(extra),
+                 ",\"baseline\":%.1f,\"change\":%.4f,\"t\":%.2f,\"df\":%.1f,"
+                 "\"regression\":%s",
+                 base.mean, change, t, df, regression ? "true" : "false");
+        success = success && !regression;
+      }
+      printf("%s%s}\n", result, extra);
+      if (output != NULL)
+        fprintf(output, "%s}\n", result);
+    }
+    fflush(stdout);
+  }
+
+  if (file != NULL)
+    fclose(file);
+  if (output != NULL)
+    fclose(output);
+  free(samples);
+  free(metric);
+  runners_timed = false;
+
+  return success;
+}
+
+/*!SECTION - Functions */
+/*!SECTION - Benchmark harness */
+#pragma endregion
+
+/*SECTION - Main function */
+/*ANCHOR - executors */
+typedef enum
+{
+  EXEC_THREADS,   /* #LINK - Pool of runners */
+  EXEC_PROCESSES, /* #LINK - Multi-process executor */
+  EXEC_CLUSTER,   /* #LINK - Distributed executor */
+  EXEC_BSP,       /* #LINK - Level-synchronous executor */
+  EXEC_PIPELINE,  /* #LINK - Pipelined executor */
+  EXEC_STATIC     /* #LINK - Static executor */
+} exec_mode_t;
+
+/*ANCHOR - usage */
+void usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [-g graphs] [-l loops] [-r runners] [-P priorities] "
+          "[-W weights]\n"
+          "       [-T periods] [-Q frames] [-A policy] [-m mode] [-K label]\n"
+          "       [-N nodes] [-t] [-G groups] [-w width] [-d depth]\n"
+          "       [-f fanin] [-e engine] [-k kind] [-S kbytes] [-H ms]\n"
+          "       [-I changes] [-M frames] [-C kbytes] [-F file] [-a] [-z]\n"
+          "       [-D depth] [-V versions] [-Y delay] [-O us] [-B threads]\n"
+          "       [-R reps] [-J file] [-E file] [-X kbytes] [-x] [-L]\n"
+          "  -g graphs      number of example graphs sharing the runners (1)\n"
+          "  -l loops       number of loops to run each graph (10)\n"
+          "  -r runners     number of runners in the pool, of each cluster node\n"
+          "                 in cluster mode (5)\n"
+          "  -P priorities  comma separated priority of each graph, 0 is the\n"
+          "                 most urgent (0,0,...)\n"
+          "  -W weights     comma separated weight of each graph within its\n"
+          "                 priority (1,1,...)\n"
+          "  -T periods     comma separated frame period of each graph in ms,\n"
+          "                 0 for back to back loops (0,0,...)\n"
+          "  -Q frames      max number of pending frames per graph (1)\n"
+          "  -A policy      full queue of frames policy: oldest, newest,\n"
+          "                 coalesce or block (oldest)\n"
+          "  -m mode        runners are 'threads', worker 'processes',\n"
+          "                 'cluster' nodes, level-synchronous 'bsp' threads or\n"
+          "                 'pipeline' threads or the 'static' executor of\n"
+          "                 the graph built in (threads); all but threads run\n"
+          "                 a single graph\n"
+          "  -N nodes       number of cluster nodes (2)\n"
+          "  -t             connect the cluster nodes with TCP over the loopback\n"
+          "                 interface instead of Unix socket pairs\n"
+          "  -G groups      partition the graphs in groups of runners (1)\n"
+          "  -K label       kill the worker process running this task\n"
+          "  -w width       run wide graphs of this width instead of the\n"
+          "                 example graph (0)\n"
+          "  -d depth       number of levels of the wide graphs (4)\n"
+          "  -f fanin       parents of each node of the wide graphs (2)\n"
+          "  -e engine      readiness of the tasks found with 'counters' or\n"
+          "                 a 'bitset' (counters)\n"
+          "  -k kind        simulated tasks 'sleep' or keep the CPU busy with\n"
+          "                 a 'spin', 'stream' or 'chase' kernel (sleep)\n"
+          "  -S kbytes      working set of the stream and chase kernels, per\n"
+          "                 runner (4096)\n"
+          "  -H ms          publish a new graph to replace each running graph\n"
+          "                 after this time, in threads mode (0)\n"
+          "  -I changes     run only the tasks changed before each loop, and\n"
+          "                 their descendants; the number of random tasks\n"
+          "                 changed, in threads mode (all tasks run)\n"
+          "  -M frames      memoise the output of the tasks, with this number\n"
+          "                 of different frames repeated cyclically, in\n"
+          "                 threads mode (no memoisation)\n"
+          "  -C kbytes      capacity of the memoisation cache (1024)\n"
+          "  -F file        memoisation cache backed by this file\n"
+          "  -a             plan the edge buffers in an arena, reusing memory\n"
+          "                 of buffers not live at the same time\n"
+          "  -z             share the output of each task with all its\n"
+          "                 children instead of copying it, in threads mode\n"
+          "  -D depth       max loops in flight in pipeline mode (2)\n"
+          "  -V versions    buffers of each edge in pipeline mode (depth)\n"
+          "  -Y delay       tasks x and y of the example graph keep state: each\n"
+          "                 waits for itself this number of loops before (0)\n"
+          "  -O us          loops started by frames pushed by an external thread\n"
+          "                 every us microseconds in a ring of -Q frames, and\n"
+          "                 collected by another thread, in threads mode\n"
+          "  -B threads     run the microbenchmarks of the runtime with 1 to\n"
+          "                 this number of threads, and exit\n"
+          "  -R reps        run the benchmark scenarios with -r runners this\n"
+          "                 number of repetitions, and exit\n"
+          "  -J file        baseline of the scenarios to check for regressions,\n"
+          "                 created if it does not exist\n"
+          "  -E file        generate the C code of the graph for the static\n"
+          "                 executor, and exit\n"
+          "  -X kbytes      scratch arena of each runner for the temporary\n"
+          "                 buffers of the tasks (no arenas)\n"
+          "  -x             reset the scratch arenas at each loop instead of\n"
+          "                 after each task; not in pipeline mode nor with\n"
+          "                 several graphs\n"
+          "  -L             back the scratch arenas with huge pages\n",
+          program);
+}
+
+/*ANCHOR - parse list */
+/* Parse a comma separated list of integers. Missing values keep the previous
+   one, so '-P 0,1' sets priority 1 to all graphs but the first.
+ */
+void parse_list(const char *list, int *values, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (list != NULL && *list != 0)
+    {
+      values[i] = atoi(list);
+      list = strchr(list, ',');
+      list = list == NULL ? NULL : list + 1;
+    }
+    else if (i > 0)
+      values[i] = values[i - 1];
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  /*ANCHOR - Graphs, Loops and Runners */
+  int count = 1;
+  int loops = 10;
+  int runners = 5;
+  char *priorities = NULL;
+  char *weights = NULL;
+  char *periods = NULL;
+  int capacity = 1;
+  admit_policy_t policy = ADMIT_DROP_OLDEST;
+  exec_mode_t mode = EXEC_THREADS;
+  int nodes = 2;
+  int groups = 1;
+  int width = 0;
+  int depth = 4;
+  int fanin = 2;
+  bool bitset = false;
+  int swap = 0;
+  int frames = 0;
+  size_t cache = 1024;
+  char *store = NULL;
+  bool arena = false;
+  bool payloads = false;
+  int pipeline = -1;
+  int versions = 0;
+  int delay = 0;
+  int stream = 0;
+  int bench = 0;
+  int reps = 0;
+  char *baseline = NULL;
+  char *codegen = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "g:l:r:P:W:T:Q:A:m:K:N:G:w:d:f:e:k:S:H:I:M:C:F:azD:V:Y:O:B:R:J:E:X:xLth")) != -1)
+  {
+    switch (opt)
+    {
+    case 'g':
+      count = atoi(optarg);
+      break;
+    case 'l':
+      loops = atoi(optarg);
+      break;
+    case 'r':
+      runners = atoi(optarg);
+      break;
+    case 'P':
+      priorities = optarg;
+      break;
+    case 'W':
+      weights = optarg;
+      break;
+    case 'T':
+      periods = optarg;
+      break;
+    case 'Q':
+      capacity = atoi(optarg);
+      break;
+    case 'A':
+      if (!admission_policy(optarg, &policy))
+      {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'm':
+      if (strcmp(optarg, "processes") == 0)
+        mode = EXEC_PROCESSES;
+      else if (strcmp(optarg, "cluster") == 0)
+        mode = EXEC_CLUSTER;
+      else if (strcmp(optarg, "bsp") == 0)
+        mode = EXEC_BSP;
+      else if (strcmp(optarg, "pipeline") == 0)
+        mode = EXEC_PIPELINE;
+      else if (strcmp(optarg, "static") == 0)
+        mode = EXEC_STATIC;
+      else if (strcmp(optarg, "threads") != 0)
+      {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'K':
+      workers_crash_label = optarg[0];
+      break;
+    case 'N':
+      nodes = atoi(optarg);
+      break;
+    case 't':
+      cluster_tcp = true;
+      break;
+    case 'G':
+      groups = atoi(optarg);
+      break;
+    case 'w':
+      width = atoi(optarg);
+      break;
+    case 'd':
+      depth = atoi(optarg);
+      break;
+    case 'f':
+      fanin = atoi(optarg);
+      break;
+    case 'e':
+      if (strcmp(optarg, "bitset") == 0)
+        bitset = true;
+      else if (strcmp(optarg, "counters") != 0)
+      {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'k':
+      if (strcmp(optarg, "spin") == 0)
+        tasks_kind = TASK_SPIN;
+      else if (strcmp(optarg, "stream") == 0)
+        tasks_kind = TASK_STREAM;
+      else if (strcmp(optarg, "chase") == 0)
+        tasks_kind = TASK_CHASE;
+      else if (strcmp(optarg, "sleep") != 0)
+      {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'S':
+      tasks_working_set = (size_t)atol(optarg) << 10;
+      break;
+    case 'H':
+      swap = atoi(optarg);
+      break;
+    case 'M':
+      frames = atoi(optarg);
+      break;
+    case 'C':
+      cache = (size_t)atol(optarg);
+      break;
+    case 'F':
+      store = optarg;
+      break;
+    case 'a':
+      arena = true;
+      break;
+    case 'z':
+      payloads = true;
+      break;
+    case 'D':
+      pipeline = atoi(optarg);
+      break;
+    case 'V':
+      versions = atoi(optarg);
+      break;
+    case 'Y':
+      delay = atoi(optarg);
+      break;
+    case 'O':
+      stream = atoi(optarg);
+      break;
+    case 'B':
+      bench = atoi(optarg);
+      break;
+    case 'R':
+      reps = atoi(optarg);
+      break;
+    case 'J':
+      baseline = optarg;
+      break;
+    case 'E':
+      codegen = optarg;
+      break;
+    case 'X':
+      scratch_size = (size_t)atol(optarg) << 10;
+      break;
+    case 'x':
+      scratch_loop = true;
+      break;
+    case 'L':
+      scratch_huge = true;
+      break;
+    case 'I':
+      incremental_changes = atoi(optarg);
+      if (incremental_changes < 0)
+      {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      usage(argv[0]);
+      exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+  }
+  if (count < 1 || loops < 1 || runners < 1 || capacity < 1 ||
+      nodes < 1 || groups < 1 || groups > runners || width < 0 || depth < 1 || fanin < 1 ||
+      tasks_working_set < sizeof(cache_line_t) * 2 || swap < 0 || frames < 0 ||
+      pipeline == 0 || pipeline < -1 || versions < 0 || delay < 0 ||
+      (delay > 0 && width > 0) ||
+      (mode != EXEC_PIPELINE && (pipeline > 0 || versions > 0)) ||
+      stream < 0 || (stream > 0 && periods != NULL) || bench < 0 || reps < 0 ||
+      (mode != EXEC_THREADS &&
+       (count > 1 || periods != NULL || swap > 0 || incremental_changes >= 0 ||
+        frames > 0 || payloads || stream > 0)) ||
+      (mode == EXEC_PIPELINE && arena) ||
+      (payloads && (arena || incremental_changes >= 0)) ||
+      (scratch_loop && (mode == EXEC_PIPELINE || count > 1)))
+  {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  tasks_calibrate();
+  scratch_probe();
+
+  /*ANCHOR - Tasks queue init */
+  tasks_queue_init();
+
+  /*ANCHOR - Microbenchmarks */
+  if (bench > 0)
+  {
+    bench_run(bench);
+    exit(EXIT_SUCCESS);
+  }
+
+  /*ANCHOR - Benchmark harness */
+  if (reps > 0)
+  {
+    bool success = harness_run(reps, runners, baseline);
+    printf("exit %d\n", success ? EXIT_SUCCESS : EXIT_FAILURE);
+    exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  /*ANCHOR - Memoisation cache */
+  if (frames > 0)
+  {
+    graphs_frames = frames;
+    memo_init(cache << 10, store);
+  }
+  if (payloads)
+    payload_init();
+
+  /*ANCHOR - Graph creation */
+  int *priority = mcalloc(sizeof(int) * count);
+  int *weight = mcalloc(sizeof(int) * count);
+  int *period = mcalloc(sizeof(int) * count);
+  weight[0] = 1;
+  parse_list(priorities, priority, count);
+  parse_list(weights, weight, count);
+  parse_list(periods, period, count);
+
+  for (int i = 0; i < count; i++)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "graph-%d", i);
+
+    graph_t *graph = width > 0 ? graph_wide_new(name, width, depth, fanin)
+                               : graph_example_new(name);
+    graph->priority = priority[i];
+    graph->weight = weight[i] < 1 ? 1 : weight[i];
+    if (period[i] > 0)
+      graph->admission = admission_new(policy, period[i], capacity);
+    if (stream > 0)
+      stream_init(graph, capacity, capacity);
+    if (delay > 0)
+    {
+      gnode_delay(gnode_get(graph->root, 'x'), gnode_get(graph->root, 'x'), delay);
+      gnode_delay(gnode_get(graph->root, 'y'), gnode_get(graph->root, 'y'), delay);
+    }
+    gnode_print(graph->root);
+    graph_register(graph);
+    if (bitset)
+      bitset_init(graph);
+    if (incremental_changes >= 0)
+      incremental_init(graph);
+    if (frames > 0)
+      memo_graph(graph);
+    if (arena)
+      arena_plan(graph);
+    if (payloads)
+      payload_graph(graph);
+    if (groups > 1)
+    {
+      partition_multilevel(graph, groups);
+      partition_print(graph, groups);
+    }
+  }
+  tasks_queue_groups = groups;
+  free(priority);
+  free(weight);
+  free(period);
+
+  /*ANCHOR - Code generator */
+  if (codegen != NULL)
+  {
+    graph_codegen(graphs[0], codegen);
+    exit(EXIT_SUCCESS);
+  }
+
+  /*ANCHOR - Static executor */
+  if (mode == EXEC_STATIC)
+  {
+#ifdef GRAPH_STATIC
+    exec_time_print(static_run(runners, loops));
+    printf("exit %d\n", EXIT_SUCCESS);
+    exit(EXIT_SUCCESS);
+#else
+    fprintf(stderr, "Error in mode static: build with -DGRAPH_STATIC='\"file\"'\n");
+    exit(EXIT_FAILURE);
+#endif
+  }
+
+  /*ANCHOR - Worker processes */
+  if (mode == EXEC_PROCESSES)
+  {
+    bool success = workers_run(graphs[0], runners, loops);
+    exec_time_print(graphs[0]);
+    printf("exit %d\n", success ? EXIT_SUCCESS : EXIT_FAILURE);
+    exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  /*ANCHOR - Cluster nodes */
+  if (mode == EXEC_CLUSTER)
+  {
+    bool success = cluster_run(graphs[0], nodes, runners, loops);
+    printf("exit %d\n", success ? EXIT_SUCCESS : EXIT_FAILURE);
+    exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  /*ANCHOR - Level-synchronous runners */
+  if (mode == EXEC_BSP)
+  {
+    bsp_run(graphs[0], runners, loops);
+    exec_time_print(graphs[0]);
+    scratch_print(graphs[0]);
+    printf("exit %d\n", EXIT_SUCCESS);
+    exit(EXIT_SUCCESS);
+  }
+
+  /*ANCHOR - Pipelined runners */
+  if (mode == EXEC_PIPELINE)
+  {
+    if (pipeline < 0)
+      pipeline = 2;
+    pipeline_run(graphs[0], runners, pipeline, versions > 0 ? versions : pipeline, loops);
+    exec_time_print(graphs[0]);
+    scratch_print(graphs[0]);
+    printf("exit %d\n", EXIT_SUCCESS);
+    exit(EXIT_SUCCESS);
+  }
+
+  /*ANCHOR - Runners init */
+  runners_init_pool(runners);
+
+  /*ANCHOR - Runners start */
+  runners_loop(loops);
+  if (stream > 0)
+    for (int i = 0; i < graphs_count; i++)
+      stream_start(graphs[i], stream);
+
+  /*ANCHOR - Hot-swap */
+  /* the new graphs are built like the running ones, only for illustration;
+     the branch of 'c' is removed from the example graph */
+  if (swap > 0)
+  {
+    struct timespec time = {.tv_sec = swap / 1000, .tv_nsec = swap % 1000 * 1000000L};
+    thrd_sleep(&time, NULL);
+    for (int i = 0; i < count; i++)
+    {
+      char name[32];
+      snprintf(name, sizeof(name), "graph-%d", i);
+
+      graph_t *graph = width > 0 ? graph_wide_new(name, width, depth, fanin)
+                                 : graph_example_new(name);
+      graph_prepare(graph);
+      if (width == 0)
+      {
+        graph_node_delete(gnode_get(graph->root, '3'));
+        graph_node_delete(gnode_get(graph->root, '4'));
+        graph_node_delete(gnode_get(graph->root, 'c'));
+      }
+      if (bitset)
+        bitset_init(graph);
+      if (frames > 0)
+        memo_graph(graph);
+      if (arena)
+        arena_plan(graph);
+      if (payloads)
+        payload_graph(graph);
+      if (groups > 1)
+        partition_multilevel(graph, groups);
+      graph_publish(i, graph);
+    }
+  }
+
+  /*ANCHOR - Runners join */
+  runners_join();
+  for (int i = 0; i < graphs_count; i++)
+    if (graphs[i]->admission != NULL)
+      admission_join(graphs[i]);
+    else if (graphs[i]->stream != NULL)
+      stream_join(graphs[i]->stream);
+  rcu_reclaim();
+  for (int i = 0; i < graphs_count; i++)
+    if (graphs[i]->successor != NULL)
+      graph_free(graphs[i]->successor);
+
+  /*ANCHOR - Latency statistics */
+  for (int i = 0; i < graphs_count; i++)
+  {
+    exec_time_print(graphs[i]);
+    if (graphs[i]->admission != NULL)
+      admission_print(graphs[i]);
+    if (graphs[i]->stream != NULL)
+      stream_print(graphs[i]);
+    if (groups > 1)
+      printf("%s: %ld tasks run out of their group\n", graphs[i]->name, graphs[i]->stolen);
+    runner_release_print(graphs[i]);
+    if (graphs[i]->incremental)
+      incremental_print(graphs[i]);
+    if (frames > 0)
+      memo_print(graphs[i]);
+    scratch_print(graphs[i]);
+  }
+  if (frames > 0)
+    memo_print_cache();
+  if (payloads)
+    payload_print();
 
   /*TODO - Destroy all allocated resources */
 